@@ -20,6 +20,7 @@ void DebugDraw2DConfig::_bind_methods() {
 	REG_PROP(text_foreground_color, Variant::COLOR);
 	REG_PROP(text_background_color, Variant::COLOR);
 	REG_PROP(text_custom_font, Variant::OBJECT);
+	REG_PROP(text_precision, Variant::INT);
 
 #undef REG_CLASS_NAME
 }
@@ -138,3 +139,15 @@ void DebugDraw2DConfig::set_text_custom_font(const Ref<Font> &_custom_font) {
 Ref<Font> DebugDraw2DConfig::get_text_custom_font() const {
 	return text_custom_font;
 }
+
+void DebugDraw2DConfig::set_text_precision(const int &_precision) {
+	int p = Math::clamp(_precision, -1, 64);
+	if (text_precision != p) {
+		text_precision = p;
+		mark_canvas_dirty();
+	}
+}
+
+int DebugDraw2DConfig::get_text_precision() const {
+	return text_precision;
+}
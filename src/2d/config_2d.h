@@ -49,6 +49,7 @@ private:
 	Color text_foreground_color = Colors::white;
 	Color text_background_color = Colors::gray_bg;
 	Ref<Font> text_custom_font = nullptr;
+	int text_precision = -1;
 
 #pragma endregion // Exposed Parameter Values
 
@@ -120,6 +121,13 @@ public:
 	 */
 	void set_text_custom_font(const Ref<Font> &_custom_font);
 	Ref<Font> get_text_custom_font() const;
+
+	/**
+	 * Number of decimal places of floats and float vectors in the text values.
+	 * -1 keeps the default formatting of Variant.
+	 */
+	void set_text_precision(const int &_precision);
+	int get_text_precision() const;
 };
 
 VARIANT_ENUM_CAST(DebugDraw2DConfig::BlockPosition);
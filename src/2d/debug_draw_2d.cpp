@@ -10,6 +10,10 @@
 GODOT_WARNING_DISABLE()
 GODOT_WARNING_RESTORE()
 
+#if !defined(DISABLE_DEBUG_RENDERING) && defined(DEV_ENABLED)
+#include <random>
+#endif
+
 #define NEED_LEAVE (!_is_enabled_override())
 
 DebugDraw2D *DebugDraw2D::singleton = nullptr;
@@ -20,6 +24,10 @@ void DebugDraw2D::_bind_methods() {
 
 	ClassDB::bind_method(D_METHOD(NAMEOF(_on_canvas_item_draw)), &DebugDraw2D::_on_canvas_item_draw);
 
+#if !defined(DISABLE_DEBUG_RENDERING) && defined(DEV_ENABLED)
+	ClassDB::bind_method(D_METHOD(NAMEOF(_benchmark_graph_buffer), "iterations"), &DebugDraw2D::_benchmark_graph_buffer, 100);
+#endif
+
 #pragma region Parameters
 
 	REG_PROP(empty_color, Variant::COLOR, PROPERTY_HINT_NONE, "", PROPERTY_USAGE_NONE);
@@ -226,6 +234,65 @@ void DebugDraw2D::_set_custom_canvas_internal(Control *_canvas) {
 }
 #endif
 
+#if !defined(DISABLE_DEBUG_RENDERING) && defined(DEV_ENABLED)
+Dictionary DebugDraw2D::_benchmark_graph_buffer(int p_iterations) {
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<double> value_dist(0, 100);
+
+	Dictionary res;
+	for (size_t size = 256; size <= 1024 * 1024; size *= 4) {
+		// Filled and wrapped around, as in a graph that has been running for a while
+		CircularBuffer<double> buffer(size);
+		for (size_t i = 0; i < size + size / 2; i++) {
+			buffer.add(value_dist(rng));
+		}
+
+		DevBenchmark bench(p_iterations);
+		std::vector<double> new_values(bench.get_iterations());
+		for (double &v : new_values) {
+			v = value_dist(rng);
+		}
+
+		double min = 0, max = 0, avg = 0;
+
+		// The loop that was used before: `get` with a branch for each value
+		double old_usec = bench.measure("get_loop", [&]() {
+			double sum = buffer.get(0);
+			min = max = buffer.get(0);
+			for (size_t i = 1; i < buffer.size(); i++) {
+				double v = buffer.get(i);
+				if (v < min) {
+					min = v;
+				} else if (v > max) {
+					max = v;
+				}
+				sum += v;
+			}
+			avg = sum / buffer.size();
+		});
+
+		double scan_usec = bench.measure("scan", [&]() { buffer.scan_min_max_avg(&min, &max, &avg); });
+
+		size_t value_idx = 0;
+		double incremental_usec = bench.measure("incremental", [&]() {
+			buffer.add(new_values[value_idx++]);
+			buffer.get_min_max_avg(&min, &max, &avg);
+		});
+
+		double scan_min, scan_max, scan_avg;
+		buffer.scan_min_max_avg(&scan_min, &scan_max, &scan_avg);
+		bool is_matched = min == scan_min && max == scan_max && Math::is_equal_approx(avg, scan_avg);
+
+		bench.get_results()["matched"] = is_matched;
+		bench.set_speedup(old_usec, incremental_usec);
+		res[(int64_t)size] = bench.get_results();
+
+		DEV_PRINT_STD("Graph buffer benchmark (%d values): get loop %.2f usec, scan %.2f usec, add and incremental %.3f usec, matched %d\n", (int)size, old_usec, scan_usec, incremental_usec, (int)is_matched);
+	}
+	return res;
+}
+#endif
+
 void DebugDraw2D::_on_canvas_item_draw(Control *ci) {
 	ZoneScoped;
 #ifndef DISABLE_DEBUG_RENDERING
@@ -315,6 +382,8 @@ void DebugDraw2D::set_custom_canvas(Control *_canvas) {
 	ZoneScoped;
 #ifndef DISABLE_DEBUG_RENDERING
 	_set_custom_canvas_internal(_canvas);
+	// The text lines are moved to the new canvas when it is redrawn
+	mark_canvas_dirty();
 #else
 	custom_control_id = _canvas ? _canvas->get_instance_id() : 0;
 #endif
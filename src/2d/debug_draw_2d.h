@@ -55,6 +55,10 @@ private:
 	void _set_custom_canvas_internal(Control *_canvas);
 #endif
 
+#if !defined(DISABLE_DEBUG_RENDERING) && defined(DEV_ENABLED)
+	Dictionary _benchmark_graph_buffer(int p_iterations);
+#endif
+
 	void _on_canvas_item_draw(Control *ci);
 	inline bool _is_enabled_override() const;
 
@@ -3,26 +3,175 @@
 #include "debug_draw_2d.h"
 #include "utils/utils.h"
 
+GODOT_WARNING_DISABLE()
+#include <godot_cpp/classes/rendering_server.hpp>
+GODOT_WARNING_RESTORE()
+
 using namespace godot;
 
 #ifndef DISABLE_DEBUG_RENDERING
-TextGroupItem::TextGroupItem(const double &p_expiration_time, const String &p_key, const String &p_text, const int &p_priority, const Color &p_color) {
-	DEV_PRINT_STD("New " NAMEOF(TextGroupItem) " created: %s : %s\n", p_key.utf8().get_data(), p_text.utf8().get_data());
+/// These values are shared with the caller and can be changed from other threads,
+/// so they are converted to strings in `set_text` instead of being stored.
+static bool is_value_shared(const Variant::Type &p_type) {
+	switch (p_type) {
+		case Variant::OBJECT:
+		case Variant::CALLABLE:
+		case Variant::SIGNAL:
+		case Variant::DICTIONARY:
+		case Variant::ARRAY:
+			return true;
+		default:
+			return false;
+	}
+}
+
+/// Converts the common types without the generic Variant::stringify.
+/// If `p_precision` is not negative, it is used as the number of decimal places of floats and float vectors.
+static String format_value(const Variant &p_value, const int &p_precision) {
+	switch (p_value.get_type()) {
+		case Variant::NIL:
+			return String();
+		case Variant::BOOL:
+			return (bool)p_value ? "true" : "false";
+		case Variant::INT:
+			return String::num_int64((int64_t)p_value);
+		case Variant::STRING:
+			return (String)p_value;
+		default:
+			break;
+	}
+
+	if (p_precision >= 0) {
+		auto format_float = [&p_precision](const double &p_val) -> String {
+			return String::num(p_val, p_precision);
+		};
+
+		switch (p_value.get_type()) {
+			case Variant::FLOAT:
+				return format_float((double)p_value);
+			case Variant::VECTOR2: {
+				const Vector2 v = p_value;
+				return "(" + format_float(v.x) + ", " + format_float(v.y) + ")";
+			}
+			case Variant::VECTOR3: {
+				const Vector3 v = p_value;
+				return "(" + format_float(v.x) + ", " + format_float(v.y) + ", " + format_float(v.z) + ")";
+			}
+			case Variant::VECTOR4: {
+				const Vector4 v = p_value;
+				return "(" + format_float(v.x) + ", " + format_float(v.y) + ", " + format_float(v.z) + ", " + format_float(v.w) + ")";
+			}
+			default:
+				break;
+		}
+	}
+
+	return p_value.stringify();
+}
+
+TextLineCanvasItem::TextLineCanvasItem(TextLineCanvasItem &&p_other) noexcept :
+		canvas_item(p_other.canvas_item),
+		parent(p_other.parent),
+		position(p_other.position),
+		is_visible(p_other.is_visible) {
+	p_other.canvas_item = RID();
+	p_other.parent = RID();
+}
+
+TextLineCanvasItem &TextLineCanvasItem::operator=(TextLineCanvasItem &&p_other) noexcept {
+	if (this != &p_other) {
+		free();
+		canvas_item = p_other.canvas_item;
+		parent = p_other.parent;
+		position = p_other.position;
+		is_visible = p_other.is_visible;
+		p_other.canvas_item = RID();
+		p_other.parent = RID();
+	}
+	return *this;
+}
+
+TextLineCanvasItem::~TextLineCanvasItem() {
+	free();
+}
+
+bool TextLineCanvasItem::attach(const RID &p_parent) {
+	RenderingServer *rs = RenderingServer::get_singleton();
+	bool is_new = false;
+
+	if (!canvas_item.is_valid()) {
+		canvas_item = rs->canvas_item_create();
+		// The graphs are drawn by the parent, so the text must stay under them as before
+		rs->canvas_item_set_draw_behind_parent(canvas_item, true);
+		parent = RID();
+		position = Vector2();
+		is_visible = true;
+		is_new = true;
+	}
+
+	if (parent != p_parent) {
+		rs->canvas_item_set_parent(canvas_item, p_parent);
+		parent = p_parent;
+	}
+	return is_new;
+}
+
+void TextLineCanvasItem::set_position(const Vector2 &p_position) {
+	if (canvas_item.is_valid() && position != p_position) {
+		RenderingServer::get_singleton()->canvas_item_set_transform(canvas_item, Transform2D(0, p_position));
+		position = p_position;
+	}
+}
+
+void TextLineCanvasItem::set_visible(const bool &p_visible) {
+	if (canvas_item.is_valid() && is_visible != p_visible) {
+		RenderingServer::get_singleton()->canvas_item_set_visible(canvas_item, p_visible);
+		is_visible = p_visible;
+	}
+}
+
+void TextLineCanvasItem::free() {
+	if (canvas_item.is_valid()) {
+		// The server may already be destroyed when the library is unloaded
+		if (RenderingServer *rs = RenderingServer::get_singleton(); rs) {
+			rs->free_rid(canvas_item);
+		}
+		canvas_item = RID();
+		parent = RID();
+	}
+}
+
+TextGroupItem::TextGroupItem(const double &p_expiration_time, const String &p_key, const Variant &p_value, const int &p_priority, const Color &p_color) {
+	DEV_PRINT_STD("New " NAMEOF(TextGroupItem) " created: %s : %s\n", p_key.utf8().get_data(), p_value.stringify().utf8().get_data());
 
 	expiration_time = p_expiration_time;
 	key = p_key;
-	text = p_text;
+	key_hash = p_key.hash();
+	value = p_value;
 	priority = p_priority;
 	value_color = p_color;
 	second_chance = true;
 }
 
-bool TextGroupItem::update(const double &p_expiration_time, const String &p_key, const String &p_text, const int &p_priority, const Color &p_color) {
-	bool dirty = expiration_time != p_expiration_time || key != p_key || text != p_text || priority != p_priority || value_color != p_color;
+bool TextGroupItem::update(const double &p_expiration_time, const String &p_key, const Variant &p_value, const int &p_priority, const Color &p_color) {
+	// Only the cheap comparisons are made here, the value is converted to a string when the line is drawn
+	bool is_value_changed = value.get_type() != p_value.get_type() || value != p_value;
+
+	bool is_text_changed = key != p_key || is_value_changed || value_color != p_color;
+	bool dirty = is_text_changed || expiration_time != p_expiration_time || priority != p_priority;
+
+	if (is_text_changed) {
+		layout.is_valid = false;
+	}
 
 	expiration_time = p_expiration_time;
-	key = p_key;
-	text = p_text;
+	if (key != p_key) {
+		key = p_key;
+		key_hash = p_key.hash();
+	}
+	if (is_value_changed) {
+		value = p_value;
+	}
 	priority = p_priority;
 	value_color = p_color;
 	second_chance = true;
@@ -34,6 +183,91 @@ bool TextGroupItem::is_expired() {
 	return expiration_time > 0 ? false : !second_chance;
 }
 
+const TextGroupItem::Layout &TextGroupItem::get_layout(const Ref<Font> &p_font, const int &p_font_size, const int &p_precision) {
+	if (layout.is_valid && layout.font == p_font && layout.font_size == p_font_size && layout.precision == p_precision) {
+		return layout;
+	}
+
+	ZoneScoped;
+	static const String separator = " : ";
+
+	layout.is_valid = true;
+	layout.font = p_font;
+	layout.font_size = p_font_size;
+	layout.precision = p_precision;
+	drawn.is_valid = false;
+
+	{
+		ZoneScopedN("stringify");
+		text = format_value(value, p_precision);
+	}
+
+	// The shaped texts are reused, so their RIDs are kept between the changes
+	if (layout.first_part.is_null()) {
+		layout.first_part.instantiate();
+	} else {
+		layout.first_part->clear();
+	}
+
+	const bool is_title_only = text.is_empty();
+	if (is_title_only || value_color == Colors::empty_color) {
+		// Both parts with same color
+		layout.first_part->add_string(is_title_only ? key : key + separator + text, p_font, p_font_size);
+		layout.value_part.unref();
+		layout.value_offset = 0;
+		layout.size = layout.first_part->get_size();
+	} else {
+		// Both parts with different colors
+		layout.first_part->add_string(key + separator, p_font, p_font_size);
+		if (layout.value_part.is_null()) {
+			layout.value_part.instantiate();
+		} else {
+			layout.value_part->clear();
+		}
+		layout.value_part->add_string(text, p_font, p_font_size);
+
+		const Vector2 first_size = layout.first_part->get_size();
+		const Vector2 value_size = layout.value_part->get_size();
+		layout.value_offset = first_size.x;
+		layout.size = Vector2(first_size.x + value_size.x, Math::max(first_size.y, value_size.y));
+	}
+	return layout;
+}
+
+void TextGroupItem::update_canvas_item(const RID &p_parent, const Vector2 &p_position, const Vector2 &p_padding, const Color &p_background_color, const Color &p_color) {
+	if (canvas.attach(p_parent)) {
+		drawn.is_valid = false;
+	}
+	canvas.set_position(p_position);
+	canvas.set_visible(true);
+
+	const Vector2 size = (layout.size + p_padding * 2).floor();
+	if (drawn.is_valid && drawn.size == size && drawn.padding == p_padding && drawn.background_color == p_background_color && drawn.color == p_color) {
+		return;
+	}
+
+	ZoneScoped;
+	drawn.is_valid = true;
+	drawn.size = size;
+	drawn.padding = p_padding;
+	drawn.background_color = p_background_color;
+	drawn.color = p_color;
+
+	RenderingServer *rs = RenderingServer::get_singleton();
+	const RID &ci = canvas.get_rid();
+	rs->canvas_item_clear(ci);
+	rs->canvas_item_add_rect(ci, Rect2(Vector2(), size), p_background_color);
+
+	layout.first_part->draw(ci, p_padding.floor(), p_color);
+	if (layout.value_part.is_valid()) {
+		layout.value_part->draw(ci, Vector2(p_padding.x + layout.value_offset, p_padding.y).floor(), value_color);
+	}
+}
+
+void TextGroupItem::hide_canvas_item() {
+	canvas.set_visible(false);
+}
+
 void TextGroup::set_group_priority(int p_val) {
 	if (group_priority != p_val)
 		owner->mark_canvas_dirty();
@@ -84,16 +318,20 @@ int TextGroup::get_text_size() {
 	return text_size;
 }
 
-TextGroup::TextGroup(DebugDraw2D *p_owner, const String &p_title, const int &p_priority, const bool &p_show_title, const Color &p_group_color, const int &p_title_size, const int &p_text_size) {
+TextGroup::TextGroup(DebugDraw2D *p_owner, const String &p_title, const int &p_priority, const bool &p_show_title, const Color &p_group_color, const int &p_title_size, const int &p_text_size) :
+		title_item(0.0, p_title, Variant(), 0, Colors::empty_color) {
 	DEV_PRINT_STD("New " NAMEOF(TextGroup) " created: %s\n", p_title.utf8().get_data());
 
 	owner = p_owner;
 	title = p_title;
+	title_hash = p_title.hash();
 	group_priority = p_priority;
 	show_title = p_show_title;
 	group_color = p_group_color;
 	title_size = p_title_size;
 	text_size = p_text_size;
+
+	title_item.is_group_title = true;
 }
 
 void TextGroup::cleanup_texts(const std::function<void()> &p_update, const double &p_delta) {
@@ -102,18 +340,40 @@ void TextGroup::cleanup_texts(const std::function<void()> &p_update, const doubl
 
 	Texts.erase(std::remove_if(Texts.begin(), Texts.end(),
 						[&p_delta](auto &t) {
-							t->expiration_time -= p_delta;
-							if (t->is_expired()) {
+							t.expiration_time -= p_delta;
+							if (t.is_expired()) {
 								return true;
 							} else {
-								t->second_chance = false;
+								t.second_chance = false;
 							}
 							return false;
 						}),
 			Texts.end());
 
-	if (old_size != Texts.size() && p_update)
-		p_update();
+	if (old_size != Texts.size()) {
+		rebuild_texts_index();
+		if (p_update)
+			p_update();
+	}
+}
+
+TextGroupItem *TextGroup::find_text(const String &p_key, const uint32_t &p_key_hash) {
+	uint32_t idx = texts_index.find(p_key_hash, [this, &p_key](const uint32_t &p_idx) { return Texts[p_idx].key == p_key; });
+	return idx != HashIndex::INVALID_INDEX ? &Texts[idx] : nullptr;
+}
+
+void TextGroup::add_text(TextGroupItem &&p_item) {
+	texts_index.insert(p_item.key_hash, (uint32_t)Texts.size());
+	Texts.push_back(std::move(p_item));
+	is_texts_order_dirty = true;
+}
+
+void TextGroup::rebuild_texts_index() {
+	ZoneScoped;
+	texts_index.clear();
+	for (size_t i = 0; i < Texts.size(); i++) {
+		texts_index.insert(Texts[i].key_hash, (uint32_t)i);
+	}
 }
 
 void GroupedText::_create_new_default_group_if_needed() {
@@ -121,20 +381,36 @@ void GroupedText::_create_new_default_group_if_needed() {
 	LOCK_GUARD(datalock);
 	if (!_current_text_group) {
 		_current_text_group = std::make_shared<TextGroup>(owner, "", 0, false, owner->get_config()->get_text_foreground_color(), 0, owner->get_config()->get_text_default_size());
-		_text_groups.push_back(_current_text_group);
+		_add_group(_current_text_group);
+	}
+}
+
+TextGroup_ptr GroupedText::_find_group(const String &p_title) {
+	uint32_t idx = _groups_index.find(p_title.hash(), [this, &p_title](const uint32_t &p_idx) { return _text_groups[p_idx]->title == p_title; });
+	return idx != HashIndex::INVALID_INDEX ? _text_groups[idx] : nullptr;
+}
+
+void GroupedText::_add_group(const TextGroup_ptr &p_group) {
+	_groups_index.insert(p_group->title_hash, (uint32_t)_text_groups.size());
+	_text_groups.push_back(p_group);
+}
+
+void GroupedText::_rebuild_groups_index() {
+	_groups_index.clear();
+	for (size_t i = 0; i < _text_groups.size(); i++) {
+		_groups_index.insert(_text_groups[i]->title_hash, (uint32_t)i);
 	}
 }
 
 void GroupedText::init_group(DebugDraw2D *p_owner) {
 	owner = p_owner;
 	_current_text_group = nullptr;
-	item_for_title_of_groups = std::make_shared<TextGroupItem>(0.0f, "", "", 0, Colors::empty_color);
-	item_for_title_of_groups->is_group_title = true;
 }
 
 void GroupedText::clear_groups() {
 	LOCK_GUARD(datalock);
 	_text_groups.clear();
+	_groups_index.clear();
 }
 
 void GroupedText::cleanup_text(const double &p_delta) {
@@ -151,6 +427,7 @@ void GroupedText::cleanup_text(const double &p_delta) {
 			_text_groups.end());
 
 	if (old_size != _text_groups.size()) {
+		_rebuild_groups_index();
 		owner->mark_canvas_dirty();
 	}
 
@@ -164,13 +441,7 @@ void GroupedText::begin_text_group(const String &p_group_title, const int &p_gro
 	ZoneScoped;
 	LOCK_GUARD(datalock);
 
-	TextGroup_ptr newGroup = nullptr;
-	for (const TextGroup_ptr &g : _text_groups) {
-		if (g->title == p_group_title) {
-			newGroup = g;
-			break;
-		}
-	}
+	TextGroup_ptr newGroup = _find_group(p_group_title);
 
 	int new_title_size = p_title_size > 0 ? p_title_size : owner->get_config()->get_text_default_size();
 	int new_text_size = p_text_size > 0 ? p_text_size : owner->get_config()->get_text_default_size();
@@ -184,7 +455,7 @@ void GroupedText::begin_text_group(const String &p_group_title, const int &p_gro
 		newGroup->is_used_one_time = false;
 	} else {
 		newGroup = std::make_shared<TextGroup>(owner, p_group_title, p_group_priority, p_show_title, p_group_color, new_title_size, new_text_size);
-		_text_groups.push_back(newGroup);
+		_add_group(newGroup);
 		owner->mark_canvas_dirty();
 	}
 
@@ -195,17 +466,13 @@ void GroupedText::end_text_group() {
 	ZoneScoped;
 	LOCK_GUARD(datalock);
 
-	_current_text_group = nullptr;
-	for (const TextGroup_ptr &g : _text_groups) {
-		if (g->title == "") {
-			_current_text_group = g;
-			_current_text_group->set_show_title(false);
-			_current_text_group->set_group_priority(0);
-			_current_text_group->set_group_color(owner->get_config()->get_text_foreground_color());
-			_current_text_group->set_title_size(owner->get_config()->get_text_default_size());
-			_current_text_group->set_text_size(owner->get_config()->get_text_default_size());
-			break;
-		}
+	_current_text_group = _find_group("");
+	if (_current_text_group) {
+		_current_text_group->set_show_title(false);
+		_current_text_group->set_group_priority(0);
+		_current_text_group->set_group_color(owner->get_config()->get_text_foreground_color());
+		_current_text_group->set_title_size(owner->get_config()->get_text_default_size());
+		_current_text_group->set_text_size(owner->get_config()->get_text_default_size());
 	}
 }
 
@@ -216,11 +483,20 @@ void GroupedText::set_text(const String &p_key, const Variant &p_value, const in
 		new_duration = owner->get_config()->get_text_default_duration();
 	}
 
-	String _strVal;
-	{
+	// Plain values are converted to strings only when the line is drawn.
+	// Shared values are converted here, but containers are converted again only if their hash is changed.
+	// The hash of an Object does not depend on its state, so Objects are always converted.
+	const Variant::Type value_type = p_value.get_type();
+	const bool is_shared = is_value_shared(value_type);
+	const bool is_hashed = is_shared && value_type != Variant::OBJECT;
+	uint32_t value_hash = 0;
+	Variant value = p_value;
+	if (is_hashed) {
+		ZoneScopedN("hash");
+		value_hash = p_value.hash();
+	} else if (is_shared) {
 		ZoneScopedN("stringify");
-		if (p_value.get_type() != Variant::NIL)
-			_strVal = p_value.stringify();
+		value = p_value.stringify();
 	}
 
 	{
@@ -228,36 +504,47 @@ void GroupedText::set_text(const String &p_key, const Variant &p_value, const in
 
 		_create_new_default_group_if_needed();
 
-		TextGroupItem_ptr item;
+		TextGroupItem *item = _current_text_group->find_text(p_key, p_key.hash());
 
-		for (const auto &d : _current_text_group->Texts) {
-			if (d->key == p_key) {
-				item = d;
-				break;
+		if (is_hashed) {
+			if (item && item->has_shared_value_hash && item->shared_value_hash == value_hash) {
+				value = item->value;
+			} else {
+				ZoneScopedN("stringify");
+				value = p_value.stringify();
 			}
 		}
 
-		if (item.get()) {
-			if (item->update(new_duration, p_key, _strVal, p_priority, p_color_of_value))
+		if (item) {
+			if (item->priority != p_priority)
+				_current_text_group->is_texts_order_dirty = true;
+			if (item->update(new_duration, p_key, value, p_priority, p_color_of_value))
 				owner->mark_canvas_dirty();
 		} else {
-			_current_text_group->Texts.push_back(std::make_shared<TextGroupItem>(new_duration, p_key, _strVal, p_priority, p_color_of_value));
+			_current_text_group->add_text(TextGroupItem(new_duration, p_key, value, p_priority, p_color_of_value));
+			item = &_current_text_group->Texts.back();
 			owner->mark_canvas_dirty();
 		}
+
+		item->shared_value_hash = value_hash;
+		item->has_shared_value_hash = is_hashed;
 	}
 }
 
 void GroupedText::draw(CanvasItem *p_ci, const Ref<Font> &p_font, const Vector2 &p_vp_size) {
 	ZoneScoped;
 	LOCK_GUARD(datalock);
-	static const String separator = " : ";
 
-	std::vector<DrawRectInstance> backgrounds;
-	std::vector<DrawTextInstance> text_parts;
+	// Each line has its own canvas item, so here only the positions are updated and the changed lines are redrawn
+	std::vector<DrawLineInstance> lines;
+
+	const Vector2 text_padding = owner->get_config()->get_text_padding();
+	const Color background_color = owner->get_config()->get_text_background_color();
 
 	real_t groups_height = 0;
 	{
 		Ref<Font> draw_font = owner->get_config()->get_text_custom_font().is_null() ? p_font : owner->get_config()->get_text_custom_font();
+		const int precision = owner->get_config()->get_text_precision();
 		Vector2 pos;
 		real_t right_side_multiplier = 0;
 
@@ -270,57 +557,41 @@ void GroupedText::draw(CanvasItem *p_ci, const Ref<Font> &p_font, const Vector2
 				break;
 		}
 
-		std::sort(_text_groups.begin(), _text_groups.end(),
-				[](TextGroup_ptr const &a, TextGroup_ptr const &b) { return a->get_group_priority() < b->get_group_priority(); });
+		auto group_cmp = [](TextGroup_ptr const &a, TextGroup_ptr const &b) { return a->get_group_priority() < b->get_group_priority(); };
+		if (!std::is_sorted(_text_groups.begin(), _text_groups.end(), group_cmp)) {
+			ZoneScopedN("Sort groups");
+			std::sort(_text_groups.begin(), _text_groups.end(), group_cmp);
+			_rebuild_groups_index();
+		}
 
-		for (const TextGroup_ptr &g : _text_groups) {
-			std::vector<TextGroupItem_ptr> group_items(g->Texts.begin(), g->Texts.end());
+		auto add_line = [&](const TextGroup_ptr &g, TextGroupItem &t) {
+			const int font_size = t.is_group_title ? g->get_title_size() : g->get_text_size();
+			const TextGroupItem::Layout &layout = t.get_layout(draw_font, font_size, precision);
+			const Vector2 line_size = layout.size + text_padding * 2;
 
-			std::sort(group_items.begin(), group_items.end(), [](TextGroupItem_ptr const &a, TextGroupItem_ptr const &b) {
-				return a->priority < b->priority || (a->priority == b->priority && a->key.naturalnocasecmp_to(b->key) < 0);
-			});
+			lines.push_back(DrawLineInstance(&t, Vector2(pos.x + line_size.x * right_side_multiplier, pos.y), g->get_group_color()));
+			pos.y += line_size.y;
+		};
+
+		for (const TextGroup_ptr &g : _text_groups) {
+			if (g->is_texts_order_dirty) {
+				ZoneScopedN("Sort texts");
+				std::sort(g->Texts.begin(), g->Texts.end(), [](TextGroupItem const &a, TextGroupItem const &b) {
+					return a.priority < b.priority || (a.priority == b.priority && a.key.naturalnocasecmp_to(b.key) < 0);
+				});
+				g->rebuild_texts_index();
+				g->is_texts_order_dirty = false;
+			}
 
 			// Add title to the list
 			if (g->is_show_title()) {
-				item_for_title_of_groups->key = g->title;
-				group_items.insert(group_items.begin(), item_for_title_of_groups);
+				add_line(g, g->title_item);
+			} else {
+				g->title_item.hide_canvas_item();
 			}
 
-			for (const TextGroupItem_ptr &t : group_items) {
-				const String keyText = t->key;
-				const bool is_title_only = !t.get() || t->text == "";
-				const String text = is_title_only ? keyText : keyText + separator + t->text;
-
-				const int font_size = t->is_group_title ? g->get_title_size() : g->get_text_size();
-				const Vector2 size = draw_font->get_string_size(text, HORIZONTAL_ALIGNMENT_LEFT, -1, font_size);
-				const Vector2 text_padding = owner->get_config()->get_text_padding();
-				const Vector2 font_offset = Vector2(0, (real_t)draw_font->get_ascent(font_size)) + text_padding;
-
-				real_t size_right_revert = (size.x + text_padding.x * 2) * right_side_multiplier;
-				backgrounds.push_back(DrawRectInstance(
-						Rect2(Vector2(pos.x + size_right_revert, pos.y).floor(), Vector2(size.x + text_padding.x * 2, size.y + text_padding.y * 2).floor()),
-						owner->get_config()->get_text_background_color()));
-
-				// Draw colored string
-				if ((t.get() && t->value_color == Colors::empty_color) || is_title_only) {
-					// Both parts with same color
-					text_parts.push_back(DrawTextInstance(text, draw_font, font_size,
-							Vector2(pos.x + font_offset.x + size_right_revert, pos.y + font_offset.y).floor(),
-							g->get_group_color()));
-				} else {
-					// Both parts with different colors
-					String textSep = keyText + separator;
-					int64_t _keyLength = textSep.length();
-
-					text_parts.push_back(DrawTextInstance(text.substr(0, _keyLength), draw_font, font_size,
-							Vector2(pos.x + font_offset.x + size_right_revert, pos.y + font_offset.y).floor(),
-							g->get_group_color()));
-
-					text_parts.push_back(DrawTextInstance(text.substr(_keyLength, text.length() - _keyLength), draw_font, font_size,
-							Vector2(pos.x + font_offset.x + size_right_revert + draw_font->get_string_size(textSep, HORIZONTAL_ALIGNMENT_LEFT, -1, font_size).x, pos.y + font_offset.y).floor(),
-							t->value_color));
-				}
-				pos.y += size.y + text_padding.y * 2;
+			for (TextGroupItem &t : g->Texts) {
+				add_line(g, t);
 			}
 		}
 
@@ -350,14 +621,9 @@ void GroupedText::draw(CanvasItem *p_ci, const Ref<Font> &p_font, const Vector2
 			break;
 	}
 
-	for (auto &bg : backgrounds) {
-		bg.rect.position += pos;
-		p_ci->draw_rect(bg.rect, bg.color);
-	}
-
-	for (auto &tp : text_parts) {
-		tp.position += pos;
-		p_ci->draw_string(tp.font, tp.position, tp.text, godot::HORIZONTAL_ALIGNMENT_LEFT, -1, tp.font_size, tp.color);
+	const RID parent = p_ci->get_canvas_item();
+	for (const auto &l : lines) {
+		l.item->update_canvas_item(parent, (l.position + pos).floor(), text_padding, background_color, l.color);
 	}
 }
 
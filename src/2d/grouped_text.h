@@ -1,6 +1,8 @@
 #pragma once
 #ifndef DISABLE_DEBUG_RENDERING
 
+#include "common/colors.h"
+#include "common/hash_index.h"
 #include "utils/compiler.h"
 #include "utils/profiler.h"
 
@@ -12,13 +14,47 @@
 GODOT_WARNING_DISABLE()
 #include <godot_cpp/classes/canvas_item.hpp>
 #include <godot_cpp/classes/font.hpp>
+#include <godot_cpp/classes/text_line.hpp>
 GODOT_WARNING_RESTORE()
 using namespace godot;
 
+/// Canvas item of one text line. It is a child of the control used for drawing and keeps its draw commands,
+/// so only the changed lines are submitted to the RenderingServer again.
+/// It is drawn behind the parent, so the graphs drawn by the control stay on top of the text.
+class TextLineCanvasItem {
+	RID canvas_item;
+	RID parent;
+	Vector2 position;
+	bool is_visible = true;
+
+public:
+	TextLineCanvasItem() = default;
+	TextLineCanvasItem(const TextLineCanvasItem &) = delete;
+	TextLineCanvasItem &operator=(const TextLineCanvasItem &) = delete;
+	TextLineCanvasItem(TextLineCanvasItem &&p_other) noexcept;
+	TextLineCanvasItem &operator=(TextLineCanvasItem &&p_other) noexcept;
+	~TextLineCanvasItem();
+
+	/// Creates the canvas item or moves it to `p_parent`. Returns true if the old commands can't be reused.
+	bool attach(const RID &p_parent);
+	void set_position(const Vector2 &p_position);
+	void set_visible(const bool &p_visible);
+	void free();
+
+	const RID &get_rid() const {
+		return canvas_item;
+	}
+};
+
 class TextGroupItem {
 public:
 	String key;
-	String text;
+	uint32_t key_hash;
+	/// Raw value of a plain type or an already converted string. Plain values are converted only when the line is drawn
+	Variant value;
+	/// `Variant::hash` of the shared value that was converted to `value`, so an unchanged container is not converted again
+	uint32_t shared_value_hash = 0;
+	bool has_shared_value_hash = false;
 	int priority;
 	double expiration_time;
 	bool is_group_title = false;
@@ -29,14 +65,51 @@ public:
 	// It is necessary to avoid the endless re - creation of these objects.
 	bool second_chance = true;
 
-	TextGroupItem(const double &p_expirationTime, const String &p_key, const String &p_text, const int &p_priority, const Color &p_color);
+	/// Shaped texts and sizes used by GroupedText::draw.
+	/// Rebuilt only if the key, text or color of the item are changed, or if a different font is used.
+	struct Layout {
+		bool is_valid = false;
+		Ref<Font> font;
+		int font_size = 0;
+		int precision = -1;
+
+		/// The whole line or only the key with the separator if the value has its own color
+		Ref<TextLine> first_part;
+		/// The value drawn with `value_color` or null
+		Ref<TextLine> value_part;
+		real_t value_offset = 0;
+		Vector2 size;
+	};
+
+private:
+	Layout layout;
+
+	/// Formatted `value`. Valid only if `layout` is valid
+	String text;
+
+	/// Parameters of the commands stored in `canvas`
+	struct DrawnState {
+		bool is_valid = false;
+		Vector2 size;
+		Vector2 padding;
+		Color background_color;
+		Color color;
+	} drawn;
+	TextLineCanvasItem canvas;
 
-	bool update(const double &p_expirationTime, const String &p_key, const String &p_text, const int &p_priority, const Color &p_color);
+public:
+	TextGroupItem(const double &p_expirationTime, const String &p_key, const Variant &p_value, const int &p_priority, const Color &p_color);
+
+	bool update(const double &p_expirationTime, const String &p_key, const Variant &p_value, const int &p_priority, const Color &p_color);
 	bool is_expired();
+	/// `p_precision` is the number of decimal places of floats or -1 to use Variant::stringify
+	const Layout &get_layout(const Ref<Font> &p_font, const int &p_font_size, const int &p_precision);
+	/// Moves the canvas item of the line to `p_position` and redraws it only if its layout or style are changed.
+	/// `get_layout` must be called before this.
+	void update_canvas_item(const RID &p_parent, const Vector2 &p_position, const Vector2 &p_padding, const Color &p_background_color, const Color &p_color);
+	void hide_canvas_item();
 };
 
-using TextGroupItem_ptr = std::shared_ptr<TextGroupItem>;
-
 class TextGroup {
 private:
 	int group_priority;
@@ -47,10 +120,21 @@ private:
 
 public:
 	bool is_used_one_time = false;
+	/// Set when the items are added or their priority is changed
+	bool is_texts_order_dirty = false;
 	String title;
-	std::vector<TextGroupItem_ptr> Texts;
+	uint32_t title_hash;
+	/// Items are stored by value in one array and found using `texts_index`
+	std::vector<TextGroupItem> Texts;
+	/// Line with the title of the group. It has its own layout, so the titles are not measured on each redraw
+	TextGroupItem title_item;
 	class DebugDraw2D *owner;
 
+private:
+	HashIndex texts_index;
+
+public:
+
 	void set_group_priority(int p_val);
 	int get_group_priority();
 	void set_show_title(bool p_val);
@@ -69,46 +153,43 @@ public:
 			title_size(14),
 			text_size(12),
 			title(""),
+			title_hash(String().hash()),
+			title_item(0.0, "", Variant(), 0, Colors::empty_color),
 			owner(nullptr){};
 	TextGroup(class DebugDraw2D *p_owner, const String &p_title, const int &p_priority, const bool &p_show_title, const Color &p_group_color, const int &p_title_size, const int &p_text_size);
 	void cleanup_texts(const std::function<void()> &p_update, const double &p_delta);
+
+	TextGroupItem *find_text(const String &p_key, const uint32_t &p_key_hash);
+	void add_text(TextGroupItem &&p_item);
+	/// Must be called after changing the order of Texts
+	void rebuild_texts_index();
 };
 
 using TextGroup_ptr = std::shared_ptr<TextGroup>;
 
 class GroupedText {
-	struct DrawRectInstance {
-		Rect2 rect;
-		Color color;
-		bool filled;
-		DrawRectInstance(const Rect2 &p_rect, const Color &p_col, const bool &p_filled = true) :
-				rect(p_rect),
-				color(p_col),
-				filled(p_filled){};
-	};
-
-	struct DrawTextInstance {
-		String text;
-		Ref<Font> font;
-		int font_size;
+	struct DrawLineInstance {
+		TextGroupItem *item;
 		Vector2 position;
 		Color color;
-		DrawTextInstance(const String &p_text, const Ref<Font> &p_font, const int &p_font_size, const Vector2 &p_pos, const Color &p_col) :
-				text(p_text),
-				font(p_font),
-				font_size(p_font_size),
+		DrawLineInstance(TextGroupItem *p_item, const Vector2 &p_pos, const Color &p_col) :
+				item(p_item),
 				position(p_pos),
 				color(p_col){};
 	};
 
-	TextGroupItem_ptr item_for_title_of_groups;
 	std::vector<TextGroup_ptr> _text_groups;
+	/// Finds the groups by title. Rebuilt when the groups are removed or sorted
+	HashIndex _groups_index;
 	TextGroup_ptr _current_text_group;
 	class DebugDraw2D *owner = nullptr;
 
 	ProfiledMutex(std::recursive_mutex, datalock, "Text lock");
 
 	void _create_new_default_group_if_needed();
+	TextGroup_ptr _find_group(const String &p_title);
+	void _add_group(const TextGroup_ptr &p_group);
+	void _rebuild_groups_index();
 
 public:
 	void init_group(class DebugDraw2D *p_owner);
@@ -13,6 +13,10 @@ void DebugDraw3DConfig::_bind_methods() {
 	REG_PROP_BOOL(use_frustum_culling);
 	REG_PROP(frustum_length_scale, Variant::FLOAT);
 	REG_PROP_BOOL(force_use_camera_from_scene);
+	REG_PROP_BOOL(use_instanced_lines);
+	REG_PROP_BOOL(use_lod);
+	REG_PROP(min_screen_size, Variant::FLOAT);
+	REG_PROP_BOOL(use_occlusion_culling);
 	REG_PROP(geometry_render_layers, Variant::INT);
 	REG_PROP(line_hit_color, Variant::COLOR);
 	REG_PROP(line_after_hit_color, Variant::COLOR);
@@ -61,6 +65,38 @@ bool DebugDraw3DConfig::is_force_use_camera_from_scene() const {
 	return force_use_camera_from_scene;
 }
 
+void DebugDraw3DConfig::set_use_instanced_lines(const bool &_state) {
+	use_instanced_lines = _state;
+}
+
+bool DebugDraw3DConfig::is_use_instanced_lines() const {
+	return use_instanced_lines;
+}
+
+void DebugDraw3DConfig::set_use_lod(const bool &_state) {
+	use_lod = _state;
+}
+
+bool DebugDraw3DConfig::is_use_lod() const {
+	return use_lod;
+}
+
+void DebugDraw3DConfig::set_min_screen_size(const real_t &_size) {
+	min_screen_size = Math::max(_size, (real_t)0);
+}
+
+real_t DebugDraw3DConfig::get_min_screen_size() const {
+	return min_screen_size;
+}
+
+void DebugDraw3DConfig::set_use_occlusion_culling(const bool &_state) {
+	use_occlusion_culling = _state;
+}
+
+bool DebugDraw3DConfig::is_use_occlusion_culling() const {
+	return use_occlusion_culling;
+}
+
 void DebugDraw3DConfig::set_geometry_render_layers(const int32_t &_layers) {
 	geometry_render_layers = _layers;
 }
@@ -24,6 +24,10 @@ private:
 	bool use_frustum_culling = true;
 	real_t frustum_length_scale = 0;
 	bool force_use_camera_from_scene = false;
+	bool use_instanced_lines = false;
+	bool use_lod = false;
+	real_t min_screen_size = 0;
+	bool use_occlusion_culling = false;
 	Color line_hit_color = Colors::red;
 	Color line_after_hit_color = Colors::green;
 
@@ -64,6 +68,36 @@ public:
 	void set_force_use_camera_from_scene(const bool &_state);
 	bool is_force_use_camera_from_scene() const;
 
+	/**
+	 * Set whether thin lines are drawn as instances of a line segment instead of being added to a single mesh.
+	 * The instances share the culling and the buffer updates with the other shapes, which is faster for a large number of short lines.
+	 */
+	void set_use_instanced_lines(const bool &_state);
+	bool is_use_instanced_lines() const;
+
+	/**
+	 * Set whether spheres and cylinders that look small on the screen are drawn with simplified meshes.
+	 * The size is calculated for the cameras that are used for frustum culling.
+	 */
+	void set_use_lod(const bool &_state);
+	bool is_use_lod() const;
+
+	/**
+	 * Set the minimum size in pixels that an instance must occupy on the screen to be drawn.
+	 * Smaller instances are skipped during frustum culling. Set to 0 to draw instances of any size.
+	 * The size is calculated for the cameras that are used for frustum culling.
+	 */
+	void set_min_screen_size(const real_t &_size);
+	real_t get_min_screen_size() const;
+
+	/**
+	 * Set whether instances and lines hidden behind the occluders are culled.
+	 * Occluders are added using DebugDraw3D.add_occluder_box and DebugDraw3D.add_occluder_faces.
+	 * They are rasterized on the CPU into a low resolution depth buffer for each camera that is used for frustum culling.
+	 */
+	void set_use_occlusion_culling(const bool &_state);
+	bool is_use_occlusion_culling() const;
+
 	/**
 	 * Set the visibility layer on which the 3D geometry will be drawn.
 	 * Similar to using VisualInstance3D.layers.
@@ -71,6 +71,7 @@ real_t DebugDraw3DScopeConfig::get_plane_size() const {
 
 Ref<DebugDraw3DScopeConfig> DebugDraw3DScopeConfig::set_viewport(Viewport *_value) const {
 	data->dcd.viewport = _value;
+	data->viewport_slot = Data::NO_VIEWPORT_SLOT;
 	return Ref<DebugDraw3DScopeConfig>(this);
 }
 
@@ -114,6 +115,7 @@ DebugDraw3DScopeConfig::Data::Data() {
 	hd_sphere = false;
 	plane_size = INFINITY;
 	dcd = {};
+	viewport_slot = NO_VIEWPORT_SLOT;
 }
 
 DebugDraw3DScopeConfig::Data::Data(const std::shared_ptr<Data> &p_parent) {
@@ -124,4 +126,5 @@ DebugDraw3DScopeConfig::Data::Data(const std::shared_ptr<Data> &p_parent) {
 
 	dcd.viewport = p_parent->dcd.viewport;
 	dcd.no_depth_test = p_parent->dcd.no_depth_test;
+	viewport_slot = p_parent->viewport_slot.load(std::memory_order_relaxed);
 }
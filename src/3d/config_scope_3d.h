@@ -2,6 +2,8 @@
 
 #include "utils/compiler.h"
 
+#include <atomic>
+#include <cstdint>
 #include <functional>
 #include <memory>
 
@@ -89,12 +91,18 @@ public:
 
 	/// @private
 	struct Data {
+		static constexpr uint64_t NO_VIEWPORT_SLOT = UINT64_MAX;
+		static constexpr uint32_t MAX_VIEWPORT_SLOTS = 1024;
+
 		// Update the constructor if changes are made!
 		real_t thickness;
 		real_t center_brightness;
 		bool hd_sphere;
 		real_t plane_size;
 		DebugContainerDependent dcd;
+		/// Slot of `dcd.viewport` in DebugDraw3D packed with the generation of the slot.
+		/// It is resolved on the first draw call and must be reset when the viewport is changed.
+		std::atomic<uint64_t> viewport_slot;
 
 		Data();
 		Data(const std::shared_ptr<Data> &parent);
@@ -3,9 +3,13 @@
 #include "config_3d.h"
 #include "debug_draw_manager.h"
 #include "debug_geometry_container.h"
+#include "draw_commands.h"
 #include "gen/shared_resources.gen.h"
 #include "geometry_generators.h"
 #include "stats_3d.h"
+#include "utils/job_pool.h"
+#include "utils/occlusion_buffer.h"
+#include "utils/simd_culling.h"
 #include "utils/utils.h"
 
 GODOT_WARNING_DISABLE()
@@ -25,6 +29,10 @@ GODOT_WARNING_DISABLE()
 #endif
 GODOT_WARNING_RESTORE()
 
+#if !defined(DISABLE_DEBUG_RENDERING) && defined(DEV_ENABLED)
+#include <random>
+#endif
+
 #define NEED_LEAVE (!_is_enabled_override())
 
 #ifndef DISABLE_DEBUG_RENDERING
@@ -101,6 +109,8 @@ void DebugDraw3D::_bind_methods() {
 
 #if !defined(DISABLE_DEBUG_RENDERING) && defined(DEV_ENABLED)
 	ClassDB::bind_method(D_METHOD(NAMEOF(_save_generated_meshes)), &DebugDraw3D::_save_generated_meshes);
+	ClassDB::bind_method(D_METHOD(NAMEOF(_benchmark_frustum_culling), "count", "iterations"), &DebugDraw3D::_benchmark_frustum_culling, 100000, 100);
+	ClassDB::bind_method(D_METHOD(NAMEOF(_benchmark_direction_basis), "count", "iterations"), &DebugDraw3D::_benchmark_direction_basis, 100000, 100);
 #endif
 
 #pragma region Draw Functions
@@ -109,6 +119,8 @@ void DebugDraw3D::_bind_methods() {
 
 	ClassDB::bind_method(D_METHOD(NAMEOF(draw_sphere), "position", "radius", "color", "duration"), &DebugDraw3D::draw_sphere, 0.5f, Colors::empty_color, 0);
 	ClassDB::bind_method(D_METHOD(NAMEOF(draw_sphere_xf), "transform", "color", "duration"), &DebugDraw3D::draw_sphere_xf, Colors::empty_color, 0);
+	ClassDB::bind_method(D_METHOD(NAMEOF(draw_spheres), "positions", "radii", "colors", "duration"), &DebugDraw3D::draw_spheres, PackedFloat32Array(), PackedColorArray(), 0);
+	ClassDB::bind_method(D_METHOD(NAMEOF(draw_spheres_xf), "transforms", "colors", "duration"), &DebugDraw3D::draw_spheres_xf, PackedColorArray(), 0);
 
 	ClassDB::bind_method(D_METHOD(NAMEOF(draw_cylinder), "transform", "color", "duration"), &DebugDraw3D::draw_cylinder, Colors::empty_color, 0);
 	ClassDB::bind_method(D_METHOD(NAMEOF(draw_cylinder_ab), "a", "b", "radius", "color", "duration"), &DebugDraw3D::draw_cylinder_ab, 0.5f, Colors::empty_color, 0);
@@ -118,6 +130,8 @@ void DebugDraw3D::_bind_methods() {
 	ClassDB::bind_method(D_METHOD(NAMEOF(draw_box_xf), "transform", "color", "is_box_centered", "duration"), &DebugDraw3D::draw_box_xf, Colors::empty_color, true, 0);
 	ClassDB::bind_method(D_METHOD(NAMEOF(draw_aabb), "aabb", "color", "duration"), &DebugDraw3D::draw_aabb, Colors::empty_color, 0);
 	ClassDB::bind_method(D_METHOD(NAMEOF(draw_aabb_ab), "a", "b", "color", "duration"), &DebugDraw3D::draw_aabb_ab, Colors::empty_color, 0);
+	ClassDB::bind_method(D_METHOD(NAMEOF(draw_boxes), "positions", "sizes", "colors", "is_box_centered", "duration"), &DebugDraw3D::draw_boxes, PackedVector3Array(), PackedColorArray(), false, 0);
+	ClassDB::bind_method(D_METHOD(NAMEOF(draw_boxes_xf), "transforms", "colors", "is_box_centered", "duration"), &DebugDraw3D::draw_boxes_xf, PackedColorArray(), true, 0);
 
 	ClassDB::bind_method(D_METHOD(NAMEOF(draw_line_hit), "start", "end", "hit", "is_hit", "hit_size", "hit_color", "after_hit_color", "duration"), &DebugDraw3D::draw_line_hit, 0.25f, Colors::empty_color, Colors::empty_color, 0);
 	ClassDB::bind_method(D_METHOD(NAMEOF(draw_line_hit_offset), "start", "end", "is_hit", "unit_offset_of_hit", "hit_size", "hit_color", "after_hit_color", "duration"), &DebugDraw3D::draw_line_hit_offset, 0.5f, 0.25f, Colors::empty_color, Colors::empty_color, 0);
@@ -132,6 +146,7 @@ void DebugDraw3D::_bind_methods() {
 	ClassDB::bind_method(D_METHOD(NAMEOF(draw_arrow), "a", "b", "color", "arrow_size", "is_absolute_size", "duration"), &DebugDraw3D::draw_arrow, Colors::empty_color, 0.5f, false, 0);
 	ClassDB::bind_method(D_METHOD(NAMEOF(draw_arrow_ray), "origin", "direction", "length", "color", "arrow_size", "is_absolute_size", "duration"), &DebugDraw3D::draw_arrow_ray, Colors::empty_color, 0.5f, false, 0);
 	ClassDB::bind_method(D_METHOD(NAMEOF(draw_arrow_path), "path", "color", "arrow_size", "is_absolute_size", "duration"), &DebugDraw3D::draw_arrow_path, Colors::empty_color, 0.75f, true, 0);
+	ClassDB::bind_method(D_METHOD(NAMEOF(draw_arrows), "a", "b", "colors", "arrow_size", "is_absolute_size", "duration"), &DebugDraw3D::draw_arrows, PackedColorArray(), 0.5f, false, 0);
 
 	ClassDB::bind_method(D_METHOD(NAMEOF(draw_point_path), "path", "type", "size", "points_color", "lines_color", "duration"), &DebugDraw3D::draw_point_path, PointType::POINT_TYPE_SQUARE, 0.25f, Colors::empty_color, Colors::empty_color, 0);
 
@@ -157,6 +172,10 @@ void DebugDraw3D::_bind_methods() {
 	REG_METHOD(new_scoped_config);
 	REG_METHOD(scoped_config);
 
+	REG_METHOD(add_occluder_box, "box");
+	ClassDB::bind_method(D_METHOD(NAMEOF(add_occluder_faces), "faces", "transform"), &DebugDraw3D::add_occluder_faces, Transform3D());
+	REG_METHOD(clear_occluders);
+
 #ifndef DISABLE_DEBUG_RENDERING
 	REG_METHOD(_register_viewport_world_deferred);
 #endif
@@ -169,6 +188,12 @@ void DebugDraw3D::_bind_methods() {
 
 DebugDraw3D::DebugDraw3D() {
 	ASSIGN_SINGLETON(DebugDraw3D);
+
+#ifndef DISABLE_DEBUG_RENDERING
+	static std::atomic<uint64_t> serial_counter = 0;
+	instance_serial = ++serial_counter;
+	viewport_slot_generations = std::make_unique<std::atomic<uint32_t>[]>(MAX_VIEWPORT_SLOTS);
+#endif
 }
 
 void DebugDraw3D::init(DebugDrawManager *p_root) {
@@ -202,6 +227,10 @@ void DebugDraw3D::init(DebugDrawManager *p_root) {
 	default_scoped_config->set_hd_sphere(def_hd_sphere);
 	default_scoped_config->set_plane_size(def_plane_size == 0 ? INFINITY : def_plane_size);
 
+#ifndef DISABLE_DEBUG_RENDERING
+	job_pool = std::make_unique<JobPool>(JobPool::get_default_threads_count());
+#endif
+
 	_load_materials();
 }
 
@@ -223,6 +252,9 @@ void DebugDraw3D::process_end(double p_delta) {
 #ifndef DISABLE_DEBUG_RENDERING
 	FrameMarkStart("3D Update");
 
+	// Move the draw calls recorded by all threads to the geometry pools
+	_flush_draw_commands();
+
 	// Update 3D debug
 	for (const auto &p : debug_containers) {
 		for (const auto &dgc : p.second.dgcs) {
@@ -235,6 +267,7 @@ void DebugDraw3D::process_end(double p_delta) {
 	_clear_scoped_configs();
 	// Reset viewport cache after frame
 	viewport_to_world_cache.clear();
+	_validate_viewport_slots();
 	FrameMarkEnd("3D Update");
 #endif
 }
@@ -270,39 +303,63 @@ void DebugDraw3D::physics_process_end(double p_delta) {
 }
 
 #ifndef DISABLE_DEBUG_RENDERING
-const std::shared_ptr<DebugDraw3DScopeConfig::Data> DebugDraw3D::scoped_config_for_current_thread() {
+DrawThreadContext *DebugDraw3D::_get_thread_context() {
+	struct ThreadContextRef {
+		uint64_t owner_serial = 0;
+		std::shared_ptr<DrawThreadContext> ctx;
+	};
+	thread_local ThreadContextRef tl_ctx;
+
+	if (tl_ctx.owner_serial == instance_serial) {
+		return tl_ctx.ctx.get();
+	}
+
 	ZoneScoped;
 	LOCK_GUARD(datalock);
-	uint64_t thread = OS::get_singleton()->get_thread_caller_id();
+	tl_ctx.owner_serial = instance_serial;
+	tl_ctx.ctx = std::make_shared<DrawThreadContext>(OS::get_singleton()->get_thread_caller_id());
+	thread_contexts.push_back(tl_ctx.ctx);
+	return tl_ctx.ctx.get();
+}
 
-	const auto &it = cached_scoped_configs.find(thread);
-	if (it != cached_scoped_configs.cend()) {
-		return it->second;
+void DebugDraw3D::_mark_scoped_config_dirty(const uint64_t &p_thread_id) {
+	for (const auto &ctx : thread_contexts) {
+		if (ctx->thread_id == p_thread_id) {
+			ctx->is_scoped_config_dirty.store(true, std::memory_order_release);
+		}
 	}
+}
 
-	const auto &it_v = scoped_configs.find(thread);
-	if (it_v != scoped_configs.cend()) {
-		const auto &cfgs = it_v->second;
-		if (!cfgs.empty()) {
-			DebugDraw3DScopeConfig *tmp = cfgs.back().scfg;
-			cached_scoped_configs[thread] = tmp->data;
-			return tmp->data;
-		}
+const std::shared_ptr<DebugDraw3DScopeConfig::Data> DebugDraw3D::scoped_config_for_current_thread() {
+	ZoneScoped;
+	DrawThreadContext *ctx = _get_thread_context();
+
+	// The cached value can only be changed by this thread
+	if (!ctx->is_scoped_config_dirty.load(std::memory_order_acquire)) {
+		return ctx->scoped_config;
+	}
+
+	LOCK_GUARD(datalock);
+	ctx->is_scoped_config_dirty.store(false, std::memory_order_relaxed);
+
+	const auto &it_v = scoped_configs.find(ctx->thread_id);
+	if (it_v != scoped_configs.cend() && !it_v->second.empty()) {
+		ctx->scoped_config = it_v->second.back().scfg->data;
+	} else {
+		ctx->scoped_config = default_scoped_config.ptr()->data;
 	}
 
-	cached_scoped_configs[thread] = default_scoped_config.ptr()->data;
-	return default_scoped_config.ptr()->data;
+	return ctx->scoped_config;
 }
 
 void DebugDraw3D::_register_scoped_config(uint64_t p_thread_id, uint64_t p_guard_id, DebugDraw3DScopeConfig *p_cfg) {
 	ZoneScoped;
 	LOCK_GUARD(datalock);
 
-	uint64_t thread = OS::get_singleton()->get_thread_caller_id();
 	scoped_configs[p_thread_id].push_back(ScopedPairIdConfig(p_guard_id, p_cfg));
 
 	// Update cached value
-	cached_scoped_configs[thread] = p_cfg->data;
+	_mark_scoped_config_dirty(p_thread_id);
 }
 
 void DebugDraw3D::_unregister_scoped_config(uint64_t thread_id, uint64_t guard_id) {
@@ -316,11 +373,7 @@ void DebugDraw3D::_unregister_scoped_config(uint64_t thread_id, uint64_t guard_i
 		cfgs.erase(--res.base());
 
 		// Update cached value
-		if (!cfgs.empty()) {
-			cached_scoped_configs[thread_id] = cfgs.back().scfg->data;
-		} else {
-			cached_scoped_configs[thread_id] = default_scoped_config.ptr()->data;
-		}
+		_mark_scoped_config_dirty(thread_id);
 	}
 }
 
@@ -338,8 +391,10 @@ void DebugDraw3D::_clear_scoped_configs() {
 
 	created_scoped_configs = 0;
 
-	cached_scoped_configs.clear();
 	scoped_configs.clear();
+	for (const auto &ctx : thread_contexts) {
+		ctx->is_scoped_config_dirty.store(true, std::memory_order_release);
+	}
 
 	if (orphans)
 		PRINT_ERROR("{0} scoped configs weren't freed. Do not save scoped configurations anywhere other than function bodies.", orphans);
@@ -367,6 +422,7 @@ std::array<Ref<ArrayMesh>, 2> *DebugDraw3D::get_shared_meshes() {
 			// WIREFRAME
 
 			mat_type = MeshMaterialType::Wireframe;
+			GEN_MESH(InstanceType::LINE, GeometryGenerator::CreateMeshNative(Mesh::PrimitiveType::PRIMITIVE_LINES, GeometryGenerator::LineVertexes));
 			GEN_MESH(InstanceType::CUBE, GeometryGenerator::CreateMeshNative(Mesh::PrimitiveType::PRIMITIVE_LINES, GeometryGenerator::CubeVertexes, GeometryGenerator::CubeIndexes));
 			GEN_MESH(InstanceType::CUBE_CENTERED, GeometryGenerator::CreateMeshNative(Mesh::PrimitiveType::PRIMITIVE_LINES, GeometryGenerator::CenteredCubeVertexes, GeometryGenerator::CubeIndexes));
 			GEN_MESH(InstanceType::ARROWHEAD, GeometryGenerator::CreateMeshNative(Mesh::PrimitiveType::PRIMITIVE_LINES, GeometryGenerator::ArrowheadVertexes, GeometryGenerator::ArrowheadIndexes));
@@ -376,6 +432,11 @@ std::array<Ref<ArrayMesh>, 2> *DebugDraw3D::get_shared_meshes() {
 			GEN_MESH(InstanceType::CYLINDER, GeometryGenerator::CreateCylinderLines(16, 1, 1, 2));
 			GEN_MESH(InstanceType::CYLINDER_AB, GeometryGenerator::RotatedMesh(GeometryGenerator::CreateCylinderLines(16, 1, 1, 2), Vector3_RIGHT, Math::deg_to_rad(90.f)));
 
+			GEN_MESH(InstanceType::SPHERE_LOD1, p_use_icosphere ? GeometryGenerator::CreateIcosphereLines(0.5f, 0) : GeometryGenerator::CreateSphereLines(8, 8, 0.5f, 1));
+			GEN_MESH(InstanceType::SPHERE_LOD2, GeometryGenerator::CreateSphereLines(4, 4, 0.5f, 1));
+			GEN_MESH(InstanceType::CYLINDER_LOD1, GeometryGenerator::CreateCylinderLines(8, 1, 1, 1));
+			GEN_MESH(InstanceType::CYLINDER_AB_LOD1, GeometryGenerator::RotatedMesh(GeometryGenerator::CreateCylinderLines(8, 1, 1, 1), Vector3_RIGHT, Math::deg_to_rad(90.f)));
+
 			// VOLUMETRIC
 
 			mat_type = MeshMaterialType::Extendable;
@@ -492,6 +553,73 @@ void DebugDraw3D::_remove_debug_container(const uint64_t &p_world_id) {
 		for (const auto &p : viewport_to_remove) {
 			viewport_to_world_cache.erase(p);
 		}
+
+		for (uint32_t i = 0; i < viewport_slots.size(); i++) {
+			if (viewport_slots[i].viewport && viewport_slots[i].world_id == p_world_id) {
+				_free_viewport_slot(i);
+			}
+		}
+	}
+}
+
+uint64_t DebugDraw3D::_resolve_viewport_slot(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg) {
+	ZoneScoped;
+	LOCK_GUARD(datalock);
+
+	Viewport *vp = p_cfg->dcd.viewport;
+	uint64_t vp_id = vp->get_instance_id();
+	uint32_t idx;
+
+	const auto &it = viewport_to_slot.find(vp);
+	if (it != viewport_to_slot.end() && viewport_slots[it->second].viewport_id == vp_id) {
+		idx = it->second;
+	} else {
+		// A new viewport was created at the address of the deleted one
+		if (it != viewport_to_slot.end()) {
+			_free_viewport_slot(it->second);
+		}
+
+		if (free_viewport_slots.size()) {
+			idx = free_viewport_slots.back();
+			free_viewport_slots.pop_back();
+		} else if (viewport_slots.size() < MAX_VIEWPORT_SLOTS) {
+			idx = (uint32_t)viewport_slots.size();
+			viewport_slots.emplace_back();
+		} else {
+			PRINT_ERROR("Too many viewports are used for drawing. The limit is {0}.", MAX_VIEWPORT_SLOTS);
+			return DebugDraw3DScopeConfig::Data::NO_VIEWPORT_SLOT;
+		}
+
+		viewport_slots[idx] = { vp, vp_id, 0 };
+		viewport_to_slot[vp] = idx;
+	}
+
+	uint64_t slot = ((uint64_t)viewport_slot_generations[idx].load(std::memory_order_relaxed) << 32) | idx;
+	p_cfg->viewport_slot.store(slot, std::memory_order_relaxed);
+	return slot;
+}
+
+void DebugDraw3D::_free_viewport_slot(const uint32_t &p_idx) {
+	LOCK_GUARD(datalock);
+
+	ViewportSlot &slot = viewport_slots[p_idx];
+	if (const auto &it = viewport_to_slot.find(slot.viewport); it != viewport_to_slot.end() && it->second == p_idx) {
+		viewport_to_slot.erase(it);
+	}
+	slot = {};
+
+	viewport_slot_generations[p_idx].fetch_add(1, std::memory_order_release);
+	free_viewport_slots.push_back(p_idx);
+}
+
+void DebugDraw3D::_validate_viewport_slots() {
+	ZoneScoped;
+	LOCK_GUARD(datalock);
+
+	for (uint32_t i = 0; i < viewport_slots.size(); i++) {
+		if (viewport_slots[i].viewport && !UtilityFunctions::is_instance_id_valid(viewport_slots[i].viewport_id)) {
+			_free_viewport_slot(i);
+		}
 	}
 }
 
@@ -570,6 +698,14 @@ void DebugDraw3D::_load_materials() {
 		prefix += "#define NO_WORLD_COORD\n";
 #endif
 
+		LOAD_SHADER(mesh_shaders[(int)MeshMaterialType::Lines][variant], prefix + DD3DResources::src_resources_wireframe_unshaded_gdshader);
+
+#ifdef COMPACT_INSTANCES_ENABLED
+		if (is_compact_instance_format_supported()) {
+			prefix += "#define COMPACT_INSTANCE\n";
+		}
+#endif
+
 		LOAD_SHADER(mesh_shaders[(int)MeshMaterialType::Wireframe][variant], prefix + DD3DResources::src_resources_wireframe_unshaded_gdshader);
 		LOAD_SHADER(mesh_shaders[(int)MeshMaterialType::Billboard][variant], prefix + DD3DResources::src_resources_billboard_unshaded_gdshader);
 		LOAD_SHADER(mesh_shaders[(int)MeshMaterialType::Plane][variant], prefix + DD3DResources::src_resources_plane_unshaded_gdshader);
@@ -697,9 +833,36 @@ void DebugDraw3D::regenerate_geometry_meshes() {
 #endif
 }
 
+void DebugDraw3D::add_occluder_box(const AABB &box) {
+#ifndef DISABLE_DEBUG_RENDERING
+	LOCK_GUARD(datalock);
+	OcclusionBuffer::append_box_triangles(box, occluder_triangles);
+#endif
+}
+
+void DebugDraw3D::add_occluder_faces(const PackedVector3Array &faces, const Transform3D &transform) {
+#ifndef DISABLE_DEBUG_RENDERING
+	LOCK_GUARD(datalock);
+	int64_t count = faces.size() - faces.size() % 3;
+	occluder_triangles.reserve(occluder_triangles.size() + count);
+	for (int64_t i = 0; i < count; i++) {
+		occluder_triangles.push_back(transform.xform(faces[i]));
+	}
+#endif
+}
+
+void DebugDraw3D::clear_occluders() {
+#ifndef DISABLE_DEBUG_RENDERING
+	LOCK_GUARD(datalock);
+	occluder_triangles.clear();
+#endif
+}
+
 void DebugDraw3D::clear_all() {
 	ZoneScoped;
 #ifndef DISABLE_DEBUG_RENDERING
+	_discard_draw_commands();
+
 	for (auto &p : debug_containers) {
 		for (const auto &dgc : p.second.dgcs) {
 			if (dgc) {
@@ -718,17 +881,16 @@ void DebugDraw3D::clear_all() {
 #define CHECK_BEFORE_CALL() \
 	if (NEED_LEAVE || config->is_freeze_3d_render()) return;
 
-#define GET_SCOPED_CFG_AND_DGC()                     \
-	auto scfg = scoped_config_for_current_thread();  \
-	auto dgc = get_debug_container(scfg->dcd, true); \
-	if (!dgc) return
+#define GET_SCOPED_CFG()                            \
+	auto scfg = scoped_config_for_current_thread(); \
+	if (!scfg->dcd.viewport) return
 
 #if defined(REAL_T_IS_DOUBLE) && defined(FIX_PRECISION_ENABLED)
 #define FIX_PRECISION_TRANSFORM(xf) Transform3D(xf.basis, xf.origin - dgc->get_center_position())
-#define FIX_PRECISION_POSITION(pos) (pos - dgc->get_center_position())
+#define FIX_PRECISION_OFFSET() (dgc->get_center_position())
 #else
 #define FIX_PRECISION_TRANSFORM(xf) (xf)
-#define FIX_PRECISION_POSITION(pos) (pos)
+#define FIX_PRECISION_OFFSET() Vector3()
 #endif
 
 #ifdef DEV_ENABLED
@@ -745,6 +907,60 @@ void DebugDraw3D::_save_generated_meshes() {
 		}
 	}
 }
+
+Dictionary DebugDraw3D::_benchmark_frustum_culling(int p_count, int p_iterations) {
+	return CullingUtils::benchmark(p_count, p_iterations);
+}
+
+Dictionary DebugDraw3D::_benchmark_direction_basis(int p_count, int p_iterations) {
+	size_t count = (size_t)Math::max(p_count, 1);
+	DevBenchmark bench(p_iterations);
+
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> pos_dist(-100, 100);
+
+	// Thick lines as in record_line
+	std::vector<Vector3> lines(count * 2);
+	for (Vector3 &p : lines) {
+		p = Vector3(pos_dist(rng), pos_dist(rng), pos_dist(rng));
+	}
+	std::vector<Transform3D> xf_old(count), xf_new(count);
+
+	double old_usec = bench.measure("looking_at", [&]() {
+		for (size_t i = 0; i < count; i++) {
+			Vector3 a = lines[i * 2];
+			Vector3 diff = lines[i * 2 + 1] - a;
+			real_t len = diff.length();
+			Vector3 center = diff.normalized() * len * .5f;
+			xf_old[i] = Transform3D(Basis().looking_at(center, get_up_vector(center)).scaled(VEC3_ONE(len)), a);
+		}
+	});
+
+	double new_usec = bench.measure("direction_basis", [&]() {
+		for (size_t i = 0; i < count; i++) {
+			const Vector3 &a = lines[i * 2];
+			const Vector3 diff = lines[i * 2 + 1] - a;
+			const real_t len = diff.length();
+			xf_new[i] = Transform3D(MathUtils::get_direction_basis(diff, len, len), a);
+		}
+	});
+
+	// Only the direction of the segment must match, the rotation around it is arbitrary
+	int64_t mismatches = 0;
+	for (size_t i = 0; i < count; i++) {
+		if (!xf_old[i].basis.get_column(2).is_equal_approx(xf_new[i].basis.get_column(2))) {
+			mismatches++;
+		}
+	}
+
+	Dictionary &res = bench.get_results();
+	res["count"] = (int64_t)count;
+	res["mismatches"] = mismatches;
+	bench.set_speedup(old_usec, new_usec);
+
+	DEV_PRINT_STD("Direction basis benchmark (%d segments): looking_at %.2f usec, direction basis %.2f usec, mismatches %d\n", (int)count, old_usec, new_usec, (int)mismatches);
+	return res;
+}
 #endif
 
 Vector3 DebugDraw3D::get_up_vector(const Vector3 &p_dir) {
@@ -761,62 +977,328 @@ Vector3 DebugDraw3D::get_up_vector(const Vector3 &p_dir) {
 	return Vector3_UP;
 }
 
-void DebugDraw3D::add_or_update_line_with_thickness(real_t p_exp_time, std::unique_ptr<Vector3[]> p_lines, const size_t p_line_count, const Color &p_col, const std::function<void(DelayedRendererLine *)> p_custom_upd) {
+void DebugDraw3D::_flush_draw_commands() {
 	ZoneScoped;
-
 	LOCK_GUARD(datalock);
-	GET_SCOPED_CFG_AND_DGC();
 
-	if (!scfg->thickness) {
-		AABB aabb = MathUtils::calculate_vertex_bounds(p_lines.get(), p_line_count);
+	// Commands usually come in long series for the same viewport
+	struct {
+		uint64_t viewport_slot = DebugDraw3DScopeConfig::Data::NO_VIEWPORT_SLOT;
+		Viewport *viewport = nullptr;
+		uint64_t viewport_id = 0;
+		bool no_depth_test = false;
+		DebugGeometryContainer *dgc = nullptr;
+	} last;
+
+	auto get_dgc = [this, &last](const uint64_t &p_slot, const bool &p_no_depth_test) -> DebugGeometryContainer * {
+		if (p_slot != last.viewport_slot || p_no_depth_test != last.no_depth_test) {
+			last.viewport_slot = p_slot;
+			last.no_depth_test = p_no_depth_test;
+			last.dgc = nullptr;
+
+			// The viewport could have been deleted after the command was recorded
+			if (_is_viewport_slot_valid(p_slot)) {
+				ViewportSlot &slot = viewport_slots[(uint32_t)p_slot];
+				last.viewport = slot.viewport;
+				last.viewport_id = slot.viewport_id;
+
+				if (UtilityFunctions::is_instance_id_valid(slot.viewport_id)) {
+					last.dgc = get_debug_container(DebugDraw3DScopeConfig::DebugContainerDependent(slot.viewport, p_no_depth_test), true);
+					if (last.dgc) {
+						slot.world_id = last.dgc->get_world()->get_instance_id();
+					}
+				}
+			}
+		}
+		return last.dgc;
+	};
+
+	for (auto it = thread_contexts.begin(); it != thread_contexts.end();) {
+		const auto &ctx = *it;
+		// Only this list keeps a reference to the context of a finished thread, so no new commands will be added to it.
+		bool is_thread_finished = ctx.use_count() == 1;
+
+		ctx->instances.consume([&last, &get_dgc](DrawCommandInstance &cmd) {
+			DebugGeometryContainer *dgc = get_dgc(cmd.viewport_slot, cmd.no_depth_test);
+			if (!dgc)
+				return;
+
+			dgc->geometry_pool.add_or_update_instance(
+					cmd.viewport_slot,
+					last.viewport,
+					last.viewport_id,
+					cmd.type,
+					cmd.exp_time,
+					cmd.proc,
+					FIX_PRECISION_TRANSFORM(cmd.transform),
+					cmd.color,
+					cmd.custom,
+					cmd.bounds);
+		});
+
+		ctx->lines.consume([&ctx, &last, &get_dgc](DrawCommandLine &cmd) {
+			DebugGeometryContainer *dgc = get_dgc(cmd.viewport_slot, cmd.no_depth_test);
+			if (!dgc) {
+				ctx->line_points.pop_array(nullptr, cmd.lines_count);
+				return;
+			}
+
+			Vector3 *lines = dgc->geometry_pool.add_or_update_line(
+					cmd.viewport_slot,
+					last.viewport,
+					last.viewport_id,
+					cmd.exp_time,
+					cmd.proc,
+					cmd.lines_count,
+					cmd.color,
+					cmd.bounds);
+			ctx->line_points.pop_array(lines, cmd.lines_count);
 
 #if defined(REAL_T_IS_DOUBLE) && defined(FIX_PRECISION_ENABLED)
-		for (size_t l = 0; l < p_line_count; l++) {
-			p_lines[l] -= dgc->get_center_position();
-		}
+			for (size_t l = 0; l < cmd.lines_count; l++) {
+				lines[l] -= dgc->get_center_position();
+			}
 #endif
-		dgc->geometry_pool.add_or_update_line(
+		});
+
+		ctx->points.consume([this, &ctx, &last, &get_dgc](DrawCommandPoints &cmd) {
+			DebugGeometryContainer *dgc = get_dgc(cmd.viewport_slot, cmd.no_depth_test);
+			if (!dgc) {
+				ctx->point_positions.pop_array(nullptr, cmd.points_count);
+				return;
+			}
+
+			if (flushed_points.size() < cmd.points_count) {
+				flushed_points.resize(cmd.points_count);
+			}
+			ctx->point_positions.pop_array(flushed_points.data(), cmd.points_count);
+
+			dgc->geometry_pool.add_points(
+					cmd.viewport_slot,
+					last.viewport,
+					last.viewport_id,
+					cmd.type,
+					cmd.exp_time,
+					cmd.proc,
+					flushed_points.data(),
+					cmd.points_count,
+					cmd.scale,
+					cmd.bounds_radius,
+					cmd.color,
+					cmd.custom,
+					FIX_PRECISION_OFFSET());
+		});
+
+		if (is_thread_finished) {
+			DEV_PRINT_STD(NAMEOF(DrawThreadContext) " of the thread %d will be deleted\n", ctx->thread_id);
+			it = thread_contexts.erase(it);
+		} else {
+			it++;
+		}
+	}
+}
+
+void DebugDraw3D::_discard_draw_commands() {
+	ZoneScoped;
+	LOCK_GUARD(datalock);
+
+	for (const auto &ctx : thread_contexts) {
+		ctx->instances.consume([](DrawCommandInstance &) {});
+		ctx->lines.consume([&ctx](DrawCommandLine &cmd) { ctx->line_points.pop_array(nullptr, cmd.lines_count); });
+		ctx->points.consume([&ctx](DrawCommandPoints &cmd) { ctx->point_positions.pop_array(nullptr, cmd.points_count); });
+	}
+}
+
+void DebugDraw3D::record_instance(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg, ConvertableInstanceType p_type, const real_t &p_exp_time, const Transform3D &p_transform, const Color &p_col, const SphereBounds &p_bounds, const Color *p_custom_col) {
+	record_instance(p_cfg, GeometryPool::_scoped_config_type_convert(p_type, p_cfg), p_exp_time, p_transform, p_col, p_bounds, p_custom_col);
+}
+
+void DebugDraw3D::record_instance(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg, InstanceType p_type, const real_t &p_exp_time, const Transform3D &p_transform, const Color &p_col, const SphereBounds &p_bounds, const Color *p_custom_col) {
+	ZoneScoped;
+	DrawCommandInstance cmd;
+	cmd.viewport_slot = _get_viewport_slot(p_cfg);
+	if (cmd.viewport_slot == DebugDraw3DScopeConfig::Data::NO_VIEWPORT_SLOT) {
+		return;
+	}
+	cmd.no_depth_test = p_cfg->dcd.no_depth_test;
+	cmd.type = p_type;
+	cmd.proc = GET_PROC_TYPE();
+	cmd.exp_time = p_exp_time;
+	cmd.transform = p_transform;
+	cmd.color = p_col;
+	cmd.custom = p_custom_col ? *p_custom_col : GeometryPool::_scoped_config_to_custom(p_cfg);
+	cmd.bounds = p_bounds;
+	cmd.bounds.radius += p_cfg->thickness * 0.5f;
+
+	_get_thread_context()->instances.push(std::move(cmd));
+}
+
+Vector3 *DebugDraw3D::_get_temp_lines(const size_t &p_count) {
+	std::vector<Vector3> &lines = _get_thread_context()->temp_lines;
+	if (lines.size() < p_count) {
+		lines.resize(p_count);
+	}
+	return lines.data();
+}
+
+void DebugDraw3D::add_or_update_line_with_thickness(real_t p_exp_time, const Vector3 *p_lines, const size_t p_line_count, const Color &p_col) {
+	ZoneScoped;
+
+	GET_SCOPED_CFG();
+	record_line(scfg, p_exp_time, p_lines, p_line_count, p_col);
+}
+
+void DebugDraw3D::record_line(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &scfg, const real_t &p_exp_time, const Vector3 *p_lines, const size_t &p_line_count, const Color &p_col) {
+	ZoneScoped;
+
+	if (!scfg->thickness && !config->is_use_instanced_lines()) {
+		DrawCommandLine cmd;
+		cmd.viewport_slot = _get_viewport_slot(scfg);
+		if (cmd.viewport_slot == DebugDraw3DScopeConfig::Data::NO_VIEWPORT_SLOT) {
+			return;
+		}
+		cmd.no_depth_test = scfg->dcd.no_depth_test;
+		cmd.proc = GET_PROC_TYPE();
+		cmd.exp_time = p_exp_time;
+		cmd.bounds = MathUtils::calculate_vertex_bounds(p_lines, p_line_count);
+		cmd.lines_count = p_line_count;
+		cmd.color = p_col;
+
+		// The points must be available before the command
+		DrawThreadContext *ctx = _get_thread_context();
+		ctx->line_points.push_array(p_lines, p_line_count);
+		ctx->lines.push(std::move(cmd));
+	} else {
+		record_segments(scfg, p_exp_time, p_line_count / 2, [&](const size_t &i, Vector3 &r_a, Vector3 &r_b, Color &r_col) {
+			r_a = p_lines[i * 2];
+			r_b = p_lines[i * 2 + 1];
+			r_col = p_col;
+		});
+	}
+}
+
+template <class TFunc>
+void DebugDraw3D::record_segments(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &scfg, const real_t &p_exp_time, const size_t &p_count, TFunc p_fill) {
+	ZoneScoped;
+	ZoneValue(p_count);
+
+	if (!scfg->thickness && config->is_use_instanced_lines()) {
+		// The segment mesh goes from (0,0,0) to (0,0,-1), so only the Z axis of the basis is needed to place its end
+		record_instances(
 				scfg,
+				InstanceType::LINE,
 				p_exp_time,
-				GET_PROC_TYPE(),
-				std::move(p_lines),
-				p_line_count,
-				p_col,
-				aabb);
-	} else {
-		for (int i = 0; i < p_line_count; i += 2) {
-			ZoneScopedN("Convert AB to xf");
-			Vector3 a = p_lines.get()[i];
-			Vector3 diff = p_lines.get()[i + 1] - a;
-			real_t len = diff.length();
-			Vector3 center = diff.normalized() * len * .5f;
-			dgc->geometry_pool.add_or_update_instance(
-					scfg,
-					InstanceType::LINE_VOLUMETRIC,
-					p_exp_time,
-					GET_PROC_TYPE(),
-					Transform3D(Basis().looking_at(center, get_up_vector(center)).scaled(VEC3_ONE(len)), FIX_PRECISION_POSITION(a)), // slow
-					p_col,
-					SphereBounds(a + center, len * .5f));
+				p_count,
+				[&](const size_t &i, Transform3D &r_xf, Color &r_col, SphereBounds &r_bounds) {
+					Vector3 a, b;
+					p_fill(i, a, b, r_col);
+					const Vector3 diff = b - a;
+
+					r_xf = Transform3D(Basis(Vector3(), Vector3(), -diff), a);
+					r_bounds = SphereBounds(a + diff * .5f, diff.length() * .5f);
+				});
+	} else if (!scfg->thickness) {
+		// Each segment has its own color, so it needs its own command, but everything else is resolved once
+		DrawCommandLine cmd;
+		cmd.viewport_slot = _get_viewport_slot(scfg);
+		if (cmd.viewport_slot == DebugDraw3DScopeConfig::Data::NO_VIEWPORT_SLOT) {
+			return;
 		}
+		cmd.no_depth_test = scfg->dcd.no_depth_test;
+		cmd.proc = GET_PROC_TYPE();
+		cmd.exp_time = p_exp_time;
+		cmd.lines_count = 2;
+
+		DrawThreadContext *ctx = _get_thread_context();
+		Vector3 line[2];
+		for (size_t i = 0; i < p_count; i++) {
+			p_fill(i, line[0], line[1], cmd.color);
+			cmd.bounds = MathUtils::calculate_vertex_bounds(line, 2);
+
+			// The points must be available before the command
+			ctx->line_points.push_array(line, 2);
+			DrawCommandLine item = cmd;
+			ctx->lines.push(std::move(item));
+		}
+	} else {
+		record_instances(
+				scfg,
+				InstanceType::LINE_VOLUMETRIC,
+				p_exp_time,
+				p_count,
+				[&](const size_t &i, Transform3D &r_xf, Color &r_col, SphereBounds &r_bounds) {
+					Vector3 a, b;
+					p_fill(i, a, b, r_col);
+					const Vector3 diff = b - a;
+					const real_t len = diff.length();
+
+					r_xf = Transform3D(MathUtils::get_direction_basis(diff, len, len), a);
+					r_bounds = SphereBounds(a + diff * .5f, len * .5f);
+				});
+	}
+}
+
+template <class TFunc>
+void DebugDraw3D::record_instances(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg, const InstanceType &p_type, const real_t &p_exp_time, const size_t &p_count, TFunc p_fill) {
+	ZoneScoped;
+	ZoneValue(p_count);
+
+	// Everything that depends on the config and the current thread is resolved once
+	DrawThreadContext *ctx = _get_thread_context();
+	DrawCommandInstance cmd;
+	cmd.viewport_slot = _get_viewport_slot(p_cfg);
+	if (cmd.viewport_slot == DebugDraw3DScopeConfig::Data::NO_VIEWPORT_SLOT) {
+		return;
+	}
+	cmd.no_depth_test = p_cfg->dcd.no_depth_test;
+	cmd.type = p_type;
+	cmd.proc = GET_PROC_TYPE();
+	cmd.exp_time = p_exp_time;
+	cmd.custom = GeometryPool::_scoped_config_to_custom(p_cfg);
+	const real_t thickness_radius = p_cfg->thickness * 0.5f;
+
+	for (size_t i = 0; i < p_count; i++) {
+		p_fill(i, cmd.transform, cmd.color, cmd.bounds);
+		cmd.bounds.radius += thickness_radius;
+
+		DrawCommandInstance item = cmd;
+		ctx->instances.push(std::move(item));
 	}
 }
 
+// The arrays of the batch methods can be empty, contain one value for all objects or one value for each object.
+template <class TArray>
+static bool _is_batch_array_valid(const TArray &p_array, const int64_t &p_count, const char *p_name) {
+	if (p_array.size() > 1 && p_array.size() != p_count) {
+		PRINT_ERROR("The size of the '{0}' array must be 0, 1 or {1}. {2} is not allowed.", p_name, p_count, p_array.size());
+		return false;
+	}
+	return true;
+}
+
+template <class T>
+static _FORCE_INLINE_ T _get_batch_value(const T *p_array, const int64_t &p_size, const size_t &p_idx, const T &p_default) {
+	return p_size == 0 ? p_default : p_array[p_size == 1 ? 0 : p_idx];
+}
+
+static _FORCE_INLINE_ Color _get_batch_color(const PackedColorArray &p_colors, const size_t &p_idx, const Color &p_default) {
+	Color c = _get_batch_value(p_colors.ptr(), p_colors.size(), p_idx, Colors::empty_color);
+	return IS_DEFAULT_COLOR(c) ? p_default : c;
+}
+
 #pragma region Spheres
 
 void DebugDraw3D::draw_sphere_base(const Transform3D &transform, const Color &color, const real_t &duration) {
 	ZoneScoped;
 	CHECK_BEFORE_CALL();
 
-	LOCK_GUARD(datalock);
-	GET_SCOPED_CFG_AND_DGC();
+	GET_SCOPED_CFG();
 
-	dgc->geometry_pool.add_or_update_instance(
+	record_instance(
 			scfg,
 			ConvertableInstanceType::SPHERE,
 			duration,
-			GET_PROC_TYPE(),
-			FIX_PRECISION_TRANSFORM(transform),
+			transform,
 			IS_DEFAULT_COLOR(color) ? Colors::chartreuse : color,
 			SphereBounds(transform.origin, MathUtils::get_max_basis_length(transform.basis) * 0.5f));
 }
@@ -834,6 +1316,58 @@ void DebugDraw3D::draw_sphere_xf(const Transform3D &transform, const Color &colo
 	draw_sphere_base(transform, color, duration);
 }
 
+void DebugDraw3D::draw_spheres(const PackedVector3Array &positions, const PackedFloat32Array &radii, const PackedColorArray &colors, const real_t &duration) {
+	ZoneScoped;
+	CHECK_BEFORE_CALL();
+
+	const int64_t count = positions.size();
+	if (!count || !_is_batch_array_valid(radii, count, "radii") || !_is_batch_array_valid(colors, count, "colors")) {
+		return;
+	}
+
+	GET_SCOPED_CFG();
+
+	const Vector3 *p = positions.ptr();
+	const float *r = radii.ptr();
+	const int64_t r_size = radii.size();
+
+	record_instances(
+			scfg,
+			GeometryPool::_scoped_config_type_convert(ConvertableInstanceType::SPHERE, scfg),
+			duration,
+			count,
+			[&](const size_t &i, Transform3D &r_xf, Color &r_col, SphereBounds &r_bounds) {
+				real_t radius = _get_batch_value(r, r_size, i, 0.5f);
+				r_xf = Transform3D(Basis().scaled(VEC3_ONE(radius * 2)), p[i]);
+				r_col = _get_batch_color(colors, i, Colors::chartreuse);
+				r_bounds = SphereBounds(p[i], radius);
+			});
+}
+
+void DebugDraw3D::draw_spheres_xf(const TypedArray<Transform3D> &transforms, const PackedColorArray &colors, const real_t &duration) {
+	ZoneScoped;
+	CHECK_BEFORE_CALL();
+
+	const int64_t count = transforms.size();
+	if (!count || !_is_batch_array_valid(colors, count, "colors")) {
+		return;
+	}
+
+	GET_SCOPED_CFG();
+
+	record_instances(
+			scfg,
+			GeometryPool::_scoped_config_type_convert(ConvertableInstanceType::SPHERE, scfg),
+			duration,
+			count,
+			[&](const size_t &i, Transform3D &r_xf, Color &r_col, SphereBounds &r_bounds) {
+				r_xf = transforms[i];
+				r_col = _get_batch_color(colors, i, Colors::chartreuse);
+				// Same bounds as in draw_sphere_base
+				r_bounds = SphereBounds(r_xf.origin, MathUtils::get_max_basis_length(r_xf.basis) * 0.5f);
+			});
+}
+
 #pragma endregion // Spheres
 #pragma region Cylinders
 
@@ -841,15 +1375,13 @@ void DebugDraw3D::draw_cylinder(const Transform3D &transform, const Color &color
 	ZoneScoped;
 	CHECK_BEFORE_CALL();
 
-	LOCK_GUARD(datalock);
-	GET_SCOPED_CFG_AND_DGC();
+	GET_SCOPED_CFG();
 
-	dgc->geometry_pool.add_or_update_instance(
+	record_instance(
 			scfg,
 			ConvertableInstanceType::CYLINDER,
 			duration,
-			GET_PROC_TYPE(),
-			FIX_PRECISION_TRANSFORM(transform),
+			transform,
 			IS_DEFAULT_COLOR(color) ? Colors::forest_green : color,
 			SphereBounds(transform.origin, MathUtils::get_max_basis_length(transform.basis) * MathUtils::CylinderRadiusForSphere));
 }
@@ -858,22 +1390,16 @@ void DebugDraw3D::draw_cylinder_ab(const Vector3 &a, const Vector3 &b, const rea
 	ZoneScoped;
 	CHECK_BEFORE_CALL();
 
-	// TODO maybe someone knows a better way to solve it?
 	Vector3 diff = b - a;
-	real_t len = diff.length();
-	Vector3 half_center = diff.normalized() * len * .5f;
-	Vector3 up = get_up_vector(half_center);
-	Transform3D t = Transform3D(Basis().looking_at(half_center, up).scaled_local(Vector3(radius, radius, len)), a + half_center);
+	Transform3D t = Transform3D(MathUtils::get_direction_basis(diff, radius, diff.length()), a + diff * .5f);
 
-	LOCK_GUARD(datalock);
-	GET_SCOPED_CFG_AND_DGC();
+	GET_SCOPED_CFG();
 
-	dgc->geometry_pool.add_or_update_instance(
+	record_instance(
 			scfg,
 			ConvertableInstanceType::CYLINDER_AB,
 			duration,
-			GET_PROC_TYPE(),
-			FIX_PRECISION_TRANSFORM(t),
+			t,
 			IS_DEFAULT_COLOR(color) ? Colors::forest_green : color,
 			SphereBounds(t.origin, MathUtils::get_max_basis_length(t.basis) * MathUtils::CylinderRadiusForSphere));
 }
@@ -907,15 +1433,13 @@ void DebugDraw3D::draw_box_ab(const Vector3 &a, const Vector3 &b, const Vector3
 		// copied from draw_box_xf
 		SphereBounds sb(t.origin + half_center_orig, MathUtils::get_max_basis_length(t.basis) * MathUtils::CubeRadiusForSphere);
 
-		LOCK_GUARD(datalock);
-		GET_SCOPED_CFG_AND_DGC();
+		GET_SCOPED_CFG();
 
-		dgc->geometry_pool.add_or_update_instance(
+		record_instance(
 				scfg,
 				ConvertableInstanceType::CUBE,
 				duration,
-				GET_PROC_TYPE(),
-				FIX_PRECISION_TRANSFORM(t),
+				t,
 				IS_DEFAULT_COLOR(color) ? Colors::forest_green : color,
 				sb);
 	} else {
@@ -939,15 +1463,13 @@ void DebugDraw3D::draw_box_xf(const Transform3D &transform, const Color &color,
 		sb.position = transform.origin + (transform.basis[0] + transform.basis[1] + transform.basis[2]) * 0.5f;
 	}
 
-	LOCK_GUARD(datalock);
-	GET_SCOPED_CFG_AND_DGC();
+	GET_SCOPED_CFG();
 
-	dgc->geometry_pool.add_or_update_instance(
+	record_instance(
 			scfg,
 			is_box_centered ? ConvertableInstanceType::CUBE_CENTERED : ConvertableInstanceType::CUBE,
 			duration,
-			GET_PROC_TYPE(),
-			FIX_PRECISION_TRANSFORM(transform),
+			transform,
 			IS_DEFAULT_COLOR(color) ? Colors::forest_green : color,
 			sb);
 }
@@ -969,6 +1491,62 @@ void DebugDraw3D::draw_aabb_ab(const Vector3 &a, const Vector3 &b, const Color &
 	draw_box_xf(Transform3D(Basis().scaled(diag), bottom), color, false, duration);
 }
 
+void DebugDraw3D::draw_boxes(const PackedVector3Array &positions, const PackedVector3Array &sizes, const PackedColorArray &colors, const bool &is_box_centered, const real_t &duration) {
+	ZoneScoped;
+	CHECK_BEFORE_CALL();
+
+	const int64_t count = positions.size();
+	if (!count || !_is_batch_array_valid(sizes, count, "sizes") || !_is_batch_array_valid(colors, count, "colors")) {
+		return;
+	}
+
+	GET_SCOPED_CFG();
+
+	const Vector3 *p = positions.ptr();
+	const Vector3 *s = sizes.ptr();
+	const int64_t s_size = sizes.size();
+
+	record_instances(
+			scfg,
+			GeometryPool::_scoped_config_type_convert(is_box_centered ? ConvertableInstanceType::CUBE_CENTERED : ConvertableInstanceType::CUBE, scfg),
+			duration,
+			count,
+			[&](const size_t &i, Transform3D &r_xf, Color &r_col, SphereBounds &r_bounds) {
+				Vector3 size = _get_batch_value(s, s_size, i, VEC3_ONE(1));
+				r_xf = Transform3D(Basis().scaled(size), p[i]);
+				r_col = _get_batch_color(colors, i, Colors::forest_green);
+				// Same bounds as in draw_box_xf
+				r_bounds = SphereBounds(is_box_centered ? p[i] : p[i] + size * 0.5f, MathUtils::get_max_basis_length(r_xf.basis) * MathUtils::CubeRadiusForSphere);
+			});
+}
+
+void DebugDraw3D::draw_boxes_xf(const TypedArray<Transform3D> &transforms, const PackedColorArray &colors, const bool &is_box_centered, const real_t &duration) {
+	ZoneScoped;
+	CHECK_BEFORE_CALL();
+
+	const int64_t count = transforms.size();
+	if (!count || !_is_batch_array_valid(colors, count, "colors")) {
+		return;
+	}
+
+	GET_SCOPED_CFG();
+
+	record_instances(
+			scfg,
+			GeometryPool::_scoped_config_type_convert(is_box_centered ? ConvertableInstanceType::CUBE_CENTERED : ConvertableInstanceType::CUBE, scfg),
+			duration,
+			count,
+			[&](const size_t &i, Transform3D &r_xf, Color &r_col, SphereBounds &r_bounds) {
+				r_xf = transforms[i];
+				r_col = _get_batch_color(colors, i, Colors::forest_green);
+				// Same bounds as in draw_box_xf
+				r_bounds = SphereBounds(r_xf.origin, MathUtils::get_max_basis_length(r_xf.basis) * MathUtils::CubeRadiusForSphere);
+				if (!is_box_centered) {
+					r_bounds.position = r_xf.origin + (r_xf.basis[0] + r_xf.basis[1] + r_xf.basis[2]) * 0.5f;
+				}
+			});
+}
+
 #pragma endregion // Boxes
 #pragma region Lines
 
@@ -976,24 +1554,22 @@ void DebugDraw3D::draw_line_hit(const Vector3 &start, const Vector3 &end, const
 	ZoneScoped;
 	CHECK_BEFORE_CALL();
 
-	LOCK_GUARD(datalock);
 	if (is_hit) {
-		add_or_update_line_with_thickness(duration, std::unique_ptr<Vector3[]>(new Vector3[2]{ start, hit }), 2, IS_DEFAULT_COLOR(hit_color) ? config->get_line_hit_color() : hit_color);
-		add_or_update_line_with_thickness(duration, std::unique_ptr<Vector3[]>(new Vector3[2]{ hit, end }), 2, IS_DEFAULT_COLOR(after_hit_color) ? config->get_line_after_hit_color() : after_hit_color);
+		add_or_update_line_with_thickness(duration, std::array<Vector3, 2>{ start, hit }.data(), 2, IS_DEFAULT_COLOR(hit_color) ? config->get_line_hit_color() : hit_color);
+		add_or_update_line_with_thickness(duration, std::array<Vector3, 2>{ hit, end }.data(), 2, IS_DEFAULT_COLOR(after_hit_color) ? config->get_line_after_hit_color() : after_hit_color);
 
-		GET_SCOPED_CFG_AND_DGC();
+		GET_SCOPED_CFG();
 
-		dgc->geometry_pool.add_or_update_instance(
+		record_instance(
 				scfg,
 				InstanceType::BILLBOARD_SQUARE,
 				duration,
-				GET_PROC_TYPE(),
-				Transform3D(Basis().scaled(VEC3_ONE(hit_size)), FIX_PRECISION_POSITION(hit)),
+				Transform3D(Basis().scaled(VEC3_ONE(hit_size)), hit),
 				IS_DEFAULT_COLOR(hit_color) ? config->get_line_hit_color() : hit_color,
 				SphereBounds(hit, MathUtils::CubeRadiusForSphere * hit_size),
 				&Colors::empty_color);
 	} else {
-		add_or_update_line_with_thickness(duration, std::unique_ptr<Vector3[]>(new Vector3[2]{ start, end }), 2, IS_DEFAULT_COLOR(hit_color) ? config->get_line_hit_color() : hit_color);
+		add_or_update_line_with_thickness(duration, std::array<Vector3, 2>{ start, end }.data(), 2, IS_DEFAULT_COLOR(hit_color) ? config->get_line_hit_color() : hit_color);
 	}
 }
 
@@ -1014,7 +1590,7 @@ void DebugDraw3D::draw_line(const Vector3 &a, const Vector3 &b, const Color &col
 	ZoneScoped;
 	CHECK_BEFORE_CALL();
 
-	add_or_update_line_with_thickness(duration, std::unique_ptr<Vector3[]>(new Vector3[2]{ a, b }), 2, IS_DEFAULT_COLOR(color) ? Colors::red : color);
+	add_or_update_line_with_thickness(duration, std::array<Vector3, 2>{ a, b }.data(), 2, IS_DEFAULT_COLOR(color) ? Colors::red : color);
 }
 
 void DebugDraw3D::draw_lines(const PackedVector3Array &lines, const Color &color, const real_t &duration) {
@@ -1026,11 +1602,7 @@ void DebugDraw3D::draw_lines(const PackedVector3Array &lines, const Color &color
 		return;
 	}
 
-	size_t s = lines.size();
-	std::unique_ptr<Vector3[]> l(new Vector3[s]);
-	memcpy(l.get(), lines.ptr(), s * sizeof(Vector3));
-
-	add_or_update_line_with_thickness(duration, std::move(l), s, IS_DEFAULT_COLOR(color) ? Colors::red : color);
+	add_or_update_line_with_thickness(duration, lines.ptr(), lines.size(), IS_DEFAULT_COLOR(color) ? Colors::red : color);
 }
 
 void DebugDraw3D::draw_lines_c(const std::vector<Vector3> &lines, const Color &color, const real_t &duration) {
@@ -1042,18 +1614,14 @@ void DebugDraw3D::draw_lines_c(const std::vector<Vector3> &lines, const Color &c
 		return;
 	}
 
-	size_t s = lines.size();
-	std::unique_ptr<Vector3[]> l(new Vector3[s]);
-	memcpy(l.get(), lines.data(), s * sizeof(Vector3));
-
-	add_or_update_line_with_thickness(duration, std::move(l), s, IS_DEFAULT_COLOR(color) ? Colors::red : color);
+	add_or_update_line_with_thickness(duration, lines.data(), lines.size(), IS_DEFAULT_COLOR(color) ? Colors::red : color);
 }
 
 void DebugDraw3D::draw_ray(const Vector3 &origin, const Vector3 &direction, const real_t &length, const Color &color, const real_t &duration) {
 	ZoneScoped;
 	CHECK_BEFORE_CALL();
 
-	add_or_update_line_with_thickness(duration, std::unique_ptr<Vector3[]>(new Vector3[2]{ origin, origin + direction * length }), 2, IS_DEFAULT_COLOR(color) ? Colors::red : color);
+	add_or_update_line_with_thickness(duration, std::array<Vector3, 2>{ origin, origin + direction * length }.data(), 2, IS_DEFAULT_COLOR(color) ? Colors::red : color);
 }
 
 void DebugDraw3D::draw_line_path(const PackedVector3Array &path, const Color &color, const real_t &duration) {
@@ -1068,10 +1636,10 @@ void DebugDraw3D::draw_line_path(const PackedVector3Array &path, const Color &co
 	}
 
 	size_t s = (path.size() - 1) * 2;
-	std::unique_ptr<Vector3[]> l(new Vector3[s]);
-	GeometryGenerator::CreateLinesFromPathWireframe(path, l.get());
+	Vector3 *l = _get_temp_lines(s);
+	GeometryGenerator::CreateLinesFromPathWireframe(path, l);
 
-	add_or_update_line_with_thickness(duration, std::move(l), s, IS_DEFAULT_COLOR(color) ? Colors::light_green : color);
+	add_or_update_line_with_thickness(duration, l, s, IS_DEFAULT_COLOR(color) ? Colors::light_green : color);
 }
 
 #pragma endregion // Normal
@@ -1084,18 +1652,15 @@ void DebugDraw3D::create_arrow(const Vector3 &p_a, const Vector3 &p_b, const Col
 	Vector3 dir = (p_b - p_a);
 	real_t size = (p_is_absolute_size ? p_arrow_size : dir.length() * p_arrow_size) * 2;
 
-	Vector3 up = get_up_vector(dir);
-	Transform3D t = Transform3D(Basis().looking_at(dir, up).scaled(VEC3_ONE(size)), p_b);
+	Transform3D t = Transform3D(MathUtils::get_direction_basis(dir, size, size), p_b);
 
-	GET_SCOPED_CFG_AND_DGC();
+	GET_SCOPED_CFG();
 
-	LOCK_GUARD(datalock);
-	dgc->geometry_pool.add_or_update_instance(
+	record_instance(
 			scfg,
 			ConvertableInstanceType::ARROWHEAD,
 			p_duration,
-			GET_PROC_TYPE(),
-			FIX_PRECISION_TRANSFORM(t),
+			t,
 			IS_DEFAULT_COLOR(p_color) ? Colors::light_green : p_color,
 			SphereBounds(t.origin + t.basis.get_column(2) * 0.5f, MathUtils::ArrowRadiusForSphere * size));
 }
@@ -1104,15 +1669,13 @@ void DebugDraw3D::draw_arrowhead(const Transform3D &transform, const Color &colo
 	ZoneScoped;
 	CHECK_BEFORE_CALL();
 
-	LOCK_GUARD(datalock);
-	GET_SCOPED_CFG_AND_DGC();
+	GET_SCOPED_CFG();
 
-	dgc->geometry_pool.add_or_update_instance(
+	record_instance(
 			scfg,
 			ConvertableInstanceType::ARROWHEAD,
 			duration,
-			GET_PROC_TYPE(),
-			FIX_PRECISION_TRANSFORM(transform),
+			transform,
 			IS_DEFAULT_COLOR(color) ? Colors::light_green : color,
 			SphereBounds(transform.origin + transform.basis.get_column(2) * 0.5f, MathUtils::ArrowRadiusForSphere * MathUtils::get_max_basis_length(transform.basis)));
 }
@@ -1121,8 +1684,7 @@ void DebugDraw3D::draw_arrow(const Vector3 &a, const Vector3 &b, const Color &co
 	ZoneScoped;
 	CHECK_BEFORE_CALL();
 
-	LOCK_GUARD(datalock);
-	add_or_update_line_with_thickness(duration, std::unique_ptr<Vector3[]>(new Vector3[2]{ a, b }), 2, IS_DEFAULT_COLOR(color) ? Colors::light_green : color);
+	add_or_update_line_with_thickness(duration, std::array<Vector3, 2>{ a, b }.data(), 2, IS_DEFAULT_COLOR(color) ? Colors::light_green : color);
 	create_arrow(a, b, color, arrow_size, is_absolute_size, duration);
 }
 
@@ -1137,17 +1699,56 @@ void DebugDraw3D::draw_arrow_path(const PackedVector3Array &path, const Color &c
 	CHECK_BEFORE_CALL();
 
 	size_t s = (path.size() - 1) * 2;
-	std::unique_ptr<Vector3[]> l(new Vector3[s]);
-	GeometryGenerator::CreateLinesFromPathWireframe(path, l.get());
+	Vector3 *l = _get_temp_lines(s);
+	GeometryGenerator::CreateLinesFromPathWireframe(path, l);
 
-	LOCK_GUARD(datalock);
-	add_or_update_line_with_thickness(duration, std::move(l), s, IS_DEFAULT_COLOR(color) ? Colors::light_green : color);
+	add_or_update_line_with_thickness(duration, l, s, IS_DEFAULT_COLOR(color) ? Colors::light_green : color);
 
 	for (int64_t i = 0; i < path.size() - 1; i++) {
 		create_arrow(path[i], path[i + 1], color, arrow_size, is_absolute_size, duration);
 	}
 }
 
+void DebugDraw3D::draw_arrows(const PackedVector3Array &a, const PackedVector3Array &b, const PackedColorArray &colors, const real_t &arrow_size, const bool &is_absolute_size, const real_t &duration) {
+	ZoneScoped;
+	CHECK_BEFORE_CALL();
+
+	const int64_t count = a.size();
+	if (count != b.size()) {
+		PRINT_ERROR("The sizes of the 'a' and 'b' arrays must be equal. {0} != {1}.", count, b.size());
+		return;
+	}
+
+	if (!count || !_is_batch_array_valid(colors, count, "colors")) {
+		return;
+	}
+
+	GET_SCOPED_CFG();
+
+	const Vector3 *pa = a.ptr();
+	const Vector3 *pb = b.ptr();
+
+	record_segments(scfg, duration, count, [&](const size_t &i, Vector3 &r_a, Vector3 &r_b, Color &r_col) {
+		r_a = pa[i];
+		r_b = pb[i];
+		r_col = _get_batch_color(colors, i, Colors::light_green);
+	});
+
+	record_instances(
+			scfg,
+			GeometryPool::_scoped_config_type_convert(ConvertableInstanceType::ARROWHEAD, scfg),
+			duration,
+			count,
+			[&](const size_t &i, Transform3D &r_xf, Color &r_col, SphereBounds &r_bounds) {
+				// Same as in create_arrow
+				Vector3 dir = pb[i] - pa[i];
+				real_t size = (is_absolute_size ? arrow_size : dir.length() * arrow_size) * 2;
+				r_xf = Transform3D(MathUtils::get_direction_basis(dir, size, size), pb[i]);
+				r_col = _get_batch_color(colors, i, Colors::light_green);
+				r_bounds = SphereBounds(r_xf.origin + r_xf.basis.get_column(2) * 0.5f, MathUtils::ArrowRadiusForSphere * size);
+			});
+}
+
 #pragma endregion // Arrows
 #pragma region Points
 
@@ -1155,7 +1756,6 @@ void DebugDraw3D::draw_point_path(const PackedVector3Array &path, const PointTyp
 	ZoneScoped;
 	CHECK_BEFORE_CALL();
 
-	LOCK_GUARD(datalock);
 	draw_points(path, type, size, IS_DEFAULT_COLOR(points_color) ? Colors::red : points_color, duration);
 	draw_line_path(path, IS_DEFAULT_COLOR(lines_color) ? Colors::green : lines_color, duration);
 }
@@ -1169,15 +1769,13 @@ void DebugDraw3D::draw_square(const Vector3 &position, const real_t &size, const
 	ZoneScoped;
 	CHECK_BEFORE_CALL();
 
-	LOCK_GUARD(datalock);
-	GET_SCOPED_CFG_AND_DGC();
+	GET_SCOPED_CFG();
 
-	dgc->geometry_pool.add_or_update_instance(
+	record_instance(
 			scfg,
 			InstanceType::BILLBOARD_SQUARE,
 			duration,
-			GET_PROC_TYPE(),
-			Transform3D(Basis().scaled(VEC3_ONE(size)), FIX_PRECISION_POSITION(position)),
+			Transform3D(Basis().scaled(VEC3_ONE(size)), position),
 			IS_DEFAULT_COLOR(color) ? Colors::red : color,
 			SphereBounds(position, MathUtils::CubeRadiusForSphere * size),
 			&Colors::empty_color);
@@ -1189,23 +1787,20 @@ void DebugDraw3D::draw_plane(const Plane &plane, const Color &color, const Vecto
 
 	Color front_color = IS_DEFAULT_COLOR(color) ? Colors::plane_light_sky_blue : color;
 
-	LOCK_GUARD(datalock);
-	GET_SCOPED_CFG_AND_DGC();
+	GET_SCOPED_CFG();
 
 	Camera3D *cam = scfg->dcd.viewport ? scfg->dcd.viewport->get_camera_3d() : nullptr;
 
 	Vector3 center_pos = plane.project(anchor_point == Vector3_INF ? (cam ? cam->get_global_position() : Vector3()) : anchor_point);
 	real_t plane_size = scfg->plane_size != INFINITY ? scfg->plane_size : (cam ? (real_t)cam->get_far() : 1000);
-	Transform3D t(Basis(), center_pos);
-	t = t.looking_at(center_pos + plane.normal, get_up_vector(plane.normal)).scaled_local(VEC3_ONE(plane_size));
+	Transform3D t(MathUtils::get_direction_basis(plane.normal, plane_size, plane_size), center_pos);
 	Color custom_col = Color::from_hsv(front_color.get_h(), Math::clamp(front_color.get_s() - 0.25f, 0.f, 1.f), Math::clamp(front_color.get_v() - 0.25f, 0.f, 1.f), front_color.a);
 
-	dgc->geometry_pool.add_or_update_instance(
+	record_instance(
 			scfg,
 			InstanceType::PLANE,
 			duration,
-			GET_PROC_TYPE(),
-			FIX_PRECISION_TRANSFORM(t),
+			t,
 			front_color,
 			SphereBounds(center_pos, MathUtils::CubeRadiusForSphere * plane_size),
 			&custom_col);
@@ -1215,32 +1810,61 @@ void DebugDraw3D::draw_points(const PackedVector3Array &points, const PointType
 	ZoneScoped;
 	CHECK_BEFORE_CALL();
 
-	LOCK_GUARD(datalock);
-	for (int i = 0; i < points.size(); i++) {
-		switch (type) {
-			case PointType::POINT_TYPE_SQUARE:
-				draw_square(points[i], size, color, duration);
-				break;
-			case PointType::POINT_TYPE_SPHERE:
-				draw_sphere(points[i], size, color, duration);
-				break;
-		}
+	if (points.is_empty()) {
+		return;
+	}
+
+	GET_SCOPED_CFG();
+
+	// All points are recorded as a single command, so the config, the thread context and the container are resolved once
+	DrawCommandPoints cmd;
+	cmd.viewport_slot = _get_viewport_slot(scfg);
+	if (cmd.viewport_slot == DebugDraw3DScopeConfig::Data::NO_VIEWPORT_SLOT) {
+		return;
+	}
+	cmd.no_depth_test = scfg->dcd.no_depth_test;
+	cmd.proc = GET_PROC_TYPE();
+	cmd.exp_time = duration;
+	cmd.points_count = points.size();
+
+	switch (type) {
+		case PointType::POINT_TYPE_SQUARE:
+			// Same as in draw_square
+			cmd.type = InstanceType::BILLBOARD_SQUARE;
+			cmd.scale = size;
+			cmd.bounds_radius = MathUtils::CubeRadiusForSphere * size;
+			cmd.color = IS_DEFAULT_COLOR(color) ? Colors::red : color;
+			cmd.custom = Colors::empty_color;
+			break;
+		case PointType::POINT_TYPE_SPHERE:
+			// Same as in draw_sphere
+			cmd.type = GeometryPool::_scoped_config_type_convert(ConvertableInstanceType::SPHERE, scfg);
+			cmd.scale = size * 2;
+			cmd.bounds_radius = size;
+			cmd.color = IS_DEFAULT_COLOR(color) ? Colors::chartreuse : color;
+			cmd.custom = GeometryPool::_scoped_config_to_custom(scfg);
+			break;
+		default:
+			return;
 	}
+	cmd.bounds_radius += scfg->thickness * 0.5f;
+
+	DrawThreadContext *ctx = _get_thread_context();
+	ctx->point_positions.push_array(points.ptr(), cmd.points_count);
+	ctx->points.push(std::move(cmd));
 }
 
 void DebugDraw3D::draw_position(const Transform3D &transform, const Color &color, const real_t &duration) {
 	ZoneScoped;
 	CHECK_BEFORE_CALL();
 
-	LOCK_GUARD(datalock);
-	GET_SCOPED_CFG_AND_DGC();
+	GET_SCOPED_CFG();
 
-	dgc->geometry_pool.add_or_update_instance(
+	record_instance(
 			scfg,
 			ConvertableInstanceType::POSITION,
 			duration,
-			GET_PROC_TYPE(),
-			FIX_PRECISION_TRANSFORM(transform),
+			transform,
 			IS_DEFAULT_COLOR(color) ? Colors::crimson : color,
 			SphereBounds(transform.origin, MathUtils::get_max_basis_length(transform.basis) * MathUtils::AxisRadiusForSphere));
 }
@@ -1254,7 +1878,6 @@ void DebugDraw3D::draw_gizmo(const Transform3D &transform, const Color &color, c
 #define MINUS(axis) transform.origin - transform.basis.get_column(axis)
 #define PLUS(axis) transform.origin + transform.basis.get_column(axis)
 
-	LOCK_GUARD(datalock);
 	if (is_centered) {
 		draw_arrow(MINUS(0 /** 0.5f*/), PLUS(0 /** 0.5f*/), COLOR(x), 0.1f, true, duration);
 		draw_arrow(MINUS(1 /** 0.5f*/), PLUS(1 /** 0.5f*/), COLOR(y), 0.1f, true, duration);
@@ -1318,12 +1941,10 @@ void DebugDraw3D::draw_camera_frustum_planes_c(const std::array<Plane, 6> &plane
 	ZoneScoped;
 	CHECK_BEFORE_CALL();
 
-	size_t s = GeometryGenerator::CubeIndexes.size();
-	std::unique_ptr<Vector3[]> l(new Vector3[s]);
-	GeometryGenerator::CreateCameraFrustumLinesWireframe(planes, l.get());
+	std::array<Vector3, GeometryGenerator::CubeIndexes.size()> l;
+	GeometryGenerator::CreateCameraFrustumLinesWireframe(planes, l.data());
 
-	LOCK_GUARD(datalock);
-	add_or_update_line_with_thickness(duration, std::move(l), s, IS_DEFAULT_COLOR(color) ? Colors::red : color);
+	add_or_update_line_with_thickness(duration, l.data(), l.size(), IS_DEFAULT_COLOR(color) ? Colors::red : color);
 }
 
 void DebugDraw3D::draw_camera_frustum(const Camera3D *camera, const Color &color, const real_t &duration) {
@@ -1358,4 +1979,5 @@ void DebugDraw3D::draw_camera_frustum_planes(const Array &camera_frustum, const
 #undef GET_PROC_TYPE
 #undef CHECK_BEFORE_CALL
 #undef NEED_LEAVE
-#undef GET_SCOPED_CFG_AND_DGC
+#undef GET_SCOPED_CFG
+#undef FIX_PRECISION_TRANSFORM
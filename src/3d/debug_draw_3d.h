@@ -16,6 +16,7 @@ GODOT_WARNING_DISABLE()
 #include <godot_cpp/classes/shader.hpp>
 #include <godot_cpp/classes/shader_material.hpp>
 #include <godot_cpp/classes/sub_viewport.hpp>
+#include <godot_cpp/variant/typed_array.hpp>
 GODOT_WARNING_RESTORE()
 using namespace godot;
 
@@ -27,11 +28,15 @@ class DebugDraw3DStats;
 
 #ifndef DISABLE_DEBUG_RENDERING
 class DebugGeometryContainer;
-struct DelayedRendererLine;
+class DrawThreadContext;
+class JobPool;
+struct SphereBounds;
 #endif
 
 /// @private
 enum class MeshMaterialType : char {
+	/// Material of the lines mesh. It uses the vertex colors instead of the instance data.
+	Lines,
 	Wireframe,
 	Billboard,
 	Plane,
@@ -93,6 +98,7 @@ public:
  * ---
  * @note
  * You can use this class anywhere, including in `_physics_process` and `_process` (and probably from other threads).
+ * Calls from each thread are recorded into a separate buffer without locking and are added to the scene once per frame.
  * It is worth mentioning that physics ticks may not be called every frame or may be called several times in one frame.
  * So if you want to avoid multiple identical `draw_` calls, you can call `draw_` methods in `_process` or use such a check:
  * ```python
@@ -166,17 +172,64 @@ private:
 	};
 	// stores thread id and array of id's with ptrs
 	std::unordered_map<uint64_t, std::vector<ScopedPairIdConfig> > scoped_configs;
-	// stores thread id and most recent config
-	std::unordered_map<uint64_t, std::shared_ptr<DebugDraw3DScopeConfig::Data> > cached_scoped_configs;
 	uint64_t created_scoped_configs = 0;
 	struct {
 		uint64_t created;
 		uint64_t orphans;
 	} scoped_stats_3d = {};
 
+	/// Unique value of this instance. Used to check the thread local caches.
+	uint64_t instance_serial = 0;
+	/// Stores the draw commands of each thread that has called the `draw_*` methods
+	std::vector<std::shared_ptr<DrawThreadContext> > thread_contexts;
+	/// Positions of the recorded points are copied here before being added to the pool
+	std::vector<Vector3> flushed_points;
+	/// Threads used to cull and fill the buffers of all containers
+	std::unique_ptr<JobPool> job_pool;
+	/// Triangles of the occluders in world space. Rasterized by each container if the occlusion culling is enabled
+	std::vector<Vector3> occluder_triangles;
+
+	/// Viewports used for drawing. The scoped configs cache the index of the slot of their viewport,
+	/// so the draw commands do not need to look up the viewport or call its methods.
+	struct ViewportSlot {
+		Viewport *viewport = nullptr;
+		uint64_t viewport_id = 0;
+		/// World of the last found container. The slot is freed when this world is removed.
+		uint64_t world_id = 0;
+	};
+	static constexpr uint32_t MAX_VIEWPORT_SLOTS = DebugDraw3DScopeConfig::Data::MAX_VIEWPORT_SLOTS;
+	std::vector<ViewportSlot> viewport_slots;
+	/// Incremented when a slot is freed. Can be read without locking to check the slots cached by the scoped configs.
+	std::unique_ptr<std::atomic<uint32_t>[]> viewport_slot_generations;
+	std::vector<uint32_t> free_viewport_slots;
+	std::unordered_map<const Viewport *, uint32_t> viewport_to_slot;
+
+	/// Returns the slot of the viewport of the config packed with its generation
+	_FORCE_INLINE_ uint64_t _get_viewport_slot(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg) {
+		uint64_t slot = p_cfg->viewport_slot.load(std::memory_order_relaxed);
+		if (_is_viewport_slot_valid(slot)) {
+			return slot;
+		}
+		return _resolve_viewport_slot(p_cfg);
+	}
+	_FORCE_INLINE_ bool _is_viewport_slot_valid(const uint64_t &p_slot) const {
+		return p_slot != DebugDraw3DScopeConfig::Data::NO_VIEWPORT_SLOT && viewport_slot_generations[(uint32_t)p_slot].load(std::memory_order_acquire) == (uint32_t)(p_slot >> 32);
+	}
+	uint64_t _resolve_viewport_slot(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg);
+	void _free_viewport_slot(const uint32_t &p_idx);
+	/// Frees the slots of the deleted viewports
+	void _validate_viewport_slots();
+
 	// Inherited via IScopeStorage
 	const std::shared_ptr<DebugDraw3DScopeConfig::Data> scoped_config_for_current_thread() override;
 
+	DrawThreadContext *_get_thread_context();
+	/// Returns a buffer of the current thread to generate the points of lines without allocations
+	Vector3 *_get_temp_lines(const size_t &p_count);
+	void _mark_scoped_config_dirty(const uint64_t &p_thread_id);
+	void _flush_draw_commands();
+	void _discard_draw_commands();
+
 	// Meshes
 	/// Store meshes shared between many debug containers
 	std::vector<std::array<Ref<ArrayMesh>, (int)MeshMaterialVariant::MAX> > shared_generated_meshes;
@@ -209,13 +262,23 @@ private:
 	void _remove_debug_container(const uint64_t &p_world_id);
 
 	_FORCE_INLINE_ Vector3 get_up_vector(const Vector3 &p_dir);
-	void add_or_update_line_with_thickness(real_t p_exp_time, std::unique_ptr<Vector3[]> p_lines, const size_t p_line_count, const Color &p_col, const std::function<void(DelayedRendererLine *)> p_custom_upd = nullptr);
+	void record_instance(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg, ConvertableInstanceType p_type, const real_t &p_exp_time, const Transform3D &p_transform, const Color &p_col, const SphereBounds &p_bounds, const Color *p_custom_col = nullptr);
+	void record_instance(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg, InstanceType p_type, const real_t &p_exp_time, const Transform3D &p_transform, const Color &p_col, const SphereBounds &p_bounds, const Color *p_custom_col = nullptr);
+	template <class TFunc>
+	void record_instances(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg, const InstanceType &p_type, const real_t &p_exp_time, const size_t &p_count, TFunc p_fill);
+	void add_or_update_line_with_thickness(real_t p_exp_time, const Vector3 *p_lines, const size_t p_line_count, const Color &p_col);
+	void record_line(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &scfg, const real_t &p_exp_time, const Vector3 *p_lines, const size_t &p_line_count, const Color &p_col);
+	/// Records `p_count` separate segments with their own colors. `p_fill(i, r_a, r_b, r_col)` sets the ends and the color of a segment.
+	template <class TFunc>
+	void record_segments(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &scfg, const real_t &p_exp_time, const size_t &p_count, TFunc p_fill);
 	Node *get_root_node();
 
 	void create_arrow(const Vector3 &p_a, const Vector3 &p_b, const Color &p_color, const real_t &p_arrow_size, const bool &p_is_absolute_size, const real_t &p_duration = 0);
 
 #ifdef DEV_ENABLED
 	void _save_generated_meshes();
+	Dictionary _benchmark_frustum_culling(int p_count, int p_iterations);
+	Dictionary _benchmark_direction_basis(int p_count, int p_iterations);
 #endif
 
 #endif
@@ -286,6 +349,27 @@ public:
 
 #pragma endregion // Configs
 
+#pragma region Occluders
+	/**
+	 * Add a box that hides the geometry behind it when DebugDraw3DConfig.set_use_occlusion_culling is enabled.
+	 *
+	 * Occluders are not drawn and stay until DebugDraw3D.clear_occluders is called.
+	 */
+	void add_occluder_box(const AABB &box);
+	/**
+	 * Add triangles that hide the geometry behind them when DebugDraw3DConfig.set_use_occlusion_culling is enabled.
+	 *
+	 * @param faces Vertices of the triangles, e.g. the result of Mesh.get_faces
+	 * @param transform Transform applied to the vertices
+	 */
+	void add_occluder_faces(const PackedVector3Array &faces, const Transform3D &transform = Transform3D());
+	/**
+	 * Remove all occluders.
+	 */
+	void clear_occluders();
+
+#pragma endregion // Occluders
+
 #pragma region Exposed Parameters
 	/// @private
 	void set_empty_color(const Color &col){};
@@ -363,6 +447,29 @@ public:
 	 */
 	void draw_sphere_xf(const Transform3D &transform, const Color &color = Colors::empty_color, const real_t &duration = 0) FAKE_FUNC_IMPL;
 
+	/**
+	 * Draw many spheres as in DebugDraw3D.draw_sphere with a single call.
+	 *
+	 * `radii` and `colors` can be empty to use the default values, contain one value for all spheres or one value for each sphere.
+	 *
+	 * @param positions Centers of the spheres
+	 * @param radii Radii of the spheres
+	 * @param colors Primary colors
+	 * @param duration The duration of how long the objects will be visible
+	 */
+	void draw_spheres(const PackedVector3Array &positions, const PackedFloat32Array &radii = PackedFloat32Array(), const PackedColorArray &colors = PackedColorArray(), const real_t &duration = 0) FAKE_FUNC_IMPL;
+
+	/**
+	 * Draw many spheres as in DebugDraw3D.draw_sphere_xf with a single call.
+	 *
+	 * `colors` can be empty to use the default color, contain one value for all spheres or one value for each sphere.
+	 *
+	 * @param transforms Transforms of the spheres
+	 * @param colors Primary colors
+	 * @param duration The duration of how long the objects will be visible
+	 */
+	void draw_spheres_xf(const TypedArray<Transform3D> &transforms, const PackedColorArray &colors = PackedColorArray(), const real_t &duration = 0) FAKE_FUNC_IMPL;
+
 #pragma endregion // Spheres
 
 #pragma region Cylinders
@@ -456,6 +563,31 @@ public:
 	 */
 	void draw_aabb_ab(const Vector3 &a, const Vector3 &b, const Color &color = Colors::empty_color, const real_t &duration = 0) FAKE_FUNC_IMPL;
 
+	/**
+	 * Draw many boxes as in DebugDraw3D.draw_box with a single call.
+	 *
+	 * `sizes` and `colors` can be empty to use the default values, contain one value for all boxes or one value for each box.
+	 *
+	 * @param positions Positions of the boxes
+	 * @param sizes Sizes of the boxes
+	 * @param colors Primary colors
+	 * @param is_box_centered Set where the center of the boxes will be. In the center or in the bottom corner
+	 * @param duration The duration of how long the objects will be visible
+	 */
+	void draw_boxes(const PackedVector3Array &positions, const PackedVector3Array &sizes = PackedVector3Array(), const PackedColorArray &colors = PackedColorArray(), const bool &is_box_centered = false, const real_t &duration = 0) FAKE_FUNC_IMPL;
+
+	/**
+	 * Draw many boxes as in DebugDraw3D.draw_box_xf with a single call.
+	 *
+	 * `colors` can be empty to use the default color, contain one value for all boxes or one value for each box.
+	 *
+	 * @param transforms Transforms of the boxes
+	 * @param colors Primary colors
+	 * @param is_box_centered Set where the center of the boxes will be. In the center or in the bottom corner
+	 * @param duration The duration of how long the objects will be visible
+	 */
+	void draw_boxes_xf(const TypedArray<Transform3D> &transforms, const PackedColorArray &colors = PackedColorArray(), const bool &is_box_centered = true, const real_t &duration = 0) FAKE_FUNC_IMPL;
+
 #pragma endregion // Boxes
 
 #pragma region Lines
@@ -602,6 +734,20 @@ public:
 	 */
 	void draw_arrow_path(const PackedVector3Array &path, const Color &color = Colors::empty_color, const real_t &arrow_size = 0.75f, const bool &is_absolute_size = true, const real_t &duration = 0) FAKE_FUNC_IMPL;
 
+	/**
+	 * Draw many arrows as in DebugDraw3D.draw_arrow with a single call.
+	 *
+	 * `a` and `b` must be the same size. `colors` can be empty to use the default color, contain one value for all arrows or one value for each arrow.
+	 *
+	 * @param a Start points
+	 * @param b End points
+	 * @param colors Primary colors
+	 * @param arrow_size Size of the arrows
+	 * @param is_absolute_size Is `arrow_size` absolute or relative to the length of each line?
+	 * @param duration The duration of how long the objects will be visible
+	 */
+	void draw_arrows(const PackedVector3Array &a, const PackedVector3Array &b, const PackedColorArray &colors = PackedColorArray(), const real_t &arrow_size = 0.5f, const bool &is_absolute_size = false, const real_t &duration = 0) FAKE_FUNC_IMPL;
+
 #pragma endregion // Arrows
 #pragma region Points
 
@@ -35,7 +35,7 @@ DebugGeometryContainer::DebugGeometryContainer(class DebugDraw3D *p_root, bool p
 		rs->instance_geometry_set_flag(_immediate_instance, RenderingServer::INSTANCE_FLAG_USE_DYNAMIC_GI, false);
 		rs->instance_geometry_set_flag(_immediate_instance, RenderingServer::INSTANCE_FLAG_USE_BAKED_LIGHT, false);
 
-		Ref<ShaderMaterial> mat = owner->get_material_variant(MeshMaterialType::Wireframe, no_depth_test ? MeshMaterialVariant::NoDepth : MeshMaterialVariant::Normal);
+		Ref<ShaderMaterial> mat = owner->get_material_variant(MeshMaterialType::Lines, no_depth_test ? MeshMaterialVariant::NoDepth : MeshMaterialVariant::Normal);
 		rs->instance_geometry_set_material_override(_immediate_instance, mat->get_rid());
 
 		immediate_mesh_storage.instance = _immediate_instance;
@@ -48,6 +48,7 @@ DebugGeometryContainer::DebugGeometryContainer(class DebugDraw3D *p_root, bool p
 		auto *meshes = owner->get_shared_meshes();
 		int mat_variant = !!no_depth_test;
 
+		CreateMMI(InstanceType::LINE, meshes[(int)InstanceType::LINE][mat_variant]);
 		CreateMMI(InstanceType::CUBE, meshes[(int)InstanceType::CUBE][mat_variant]);
 		CreateMMI(InstanceType::CUBE_CENTERED, meshes[(int)InstanceType::CUBE_CENTERED][mat_variant]);
 		CreateMMI(InstanceType::ARROWHEAD, meshes[(int)InstanceType::ARROWHEAD][mat_variant]);
@@ -56,6 +57,10 @@ DebugGeometryContainer::DebugGeometryContainer(class DebugDraw3D *p_root, bool p
 		CreateMMI(InstanceType::SPHERE_HD, meshes[(int)InstanceType::SPHERE_HD][mat_variant]);
 		CreateMMI(InstanceType::CYLINDER, meshes[(int)InstanceType::CYLINDER][mat_variant]);
 		CreateMMI(InstanceType::CYLINDER_AB, meshes[(int)InstanceType::CYLINDER_AB][mat_variant]);
+		CreateMMI(InstanceType::SPHERE_LOD1, meshes[(int)InstanceType::SPHERE_LOD1][mat_variant]);
+		CreateMMI(InstanceType::SPHERE_LOD2, meshes[(int)InstanceType::SPHERE_LOD2][mat_variant]);
+		CreateMMI(InstanceType::CYLINDER_LOD1, meshes[(int)InstanceType::CYLINDER_LOD1][mat_variant]);
+		CreateMMI(InstanceType::CYLINDER_AB_LOD1, meshes[(int)InstanceType::CYLINDER_AB_LOD1][mat_variant]);
 
 		// VOLUMETRIC
 
@@ -100,7 +105,12 @@ void DebugGeometryContainer::CreateMMI(InstanceType p_type, Ref<ArrayMesh> p_mes
 	new_mm.instantiate();
 	new_mm->set_name(String::num_int64((int)p_type));
 
+#ifdef COMPACT_INSTANCES_ENABLED
+	// The color is packed into the custom data
+	new_mm->set_use_colors(!is_compact_instance_format_supported());
+#else
 	new_mm->set_use_colors(true);
+#endif
 	new_mm->set_transform_format(MultiMesh::TRANSFORM_3D);
 	new_mm->set_use_custom_data(true);
 	new_mm->set_mesh(p_mesh);
@@ -151,10 +161,10 @@ void DebugGeometryContainer::update_center_positions() {
 	Vector3 pos_diff = center_position - new_center_position;
 	center_position = new_center_position;
 
-	geometry_pool.for_each_instance([&pos_diff](DelayedRendererInstance *i) {
-		i->data.origin_x += (float)pos_diff.x;
-		i->data.origin_y += (float)pos_diff.y;
-		i->data.origin_z += (float)pos_diff.z;
+	geometry_pool.for_each_instance([&pos_diff](GeometryPoolData3DInstance *i, const AABBMinMax &, const bool &) {
+		i->origin_x += (float)pos_diff.x;
+		i->origin_y += (float)pos_diff.y;
+		i->origin_z += (float)pos_diff.z;
 	});
 
 	geometry_pool.for_each_line([&pos_diff](DelayedRendererLine *i) {
@@ -173,6 +183,42 @@ void DebugGeometryContainer::update_center_positions() {
 }
 #endif
 
+static GeometryPoolCullingData::ViewCamera _get_view_camera(Camera3D *p_cam) {
+	Vector2 vp_size = p_cam->get_viewport()->get_visible_rect().size;
+	// FOV and size are applied to the axis that keeps its size
+	real_t height = p_cam->get_keep_aspect_mode() == Camera3D::KEEP_WIDTH ? vp_size.x : vp_size.y;
+
+	if (p_cam->get_projection() == Camera3D::PROJECTION_ORTHOGONAL) {
+		return { p_cam->get_global_position(), height / (real_t)p_cam->get_size(), true };
+	}
+	return { p_cam->get_global_position(), height / (2 * Math::tan(Math::deg_to_rad((real_t)p_cam->get_fov()) * 0.5f)), false };
+}
+
+static bool _get_view_projection(Camera3D *p_cam, Projection &r_view_projection, real_t &r_aspect) {
+	Vector2 vp_size = p_cam->get_viewport()->get_visible_rect().size;
+	if (vp_size.x <= 0 || vp_size.y <= 0) {
+		return false;
+	}
+
+	r_aspect = vp_size.x / vp_size.y;
+	bool flip_fov = p_cam->get_keep_aspect_mode() == Camera3D::KEEP_WIDTH;
+	Projection proj;
+	switch (p_cam->get_projection()) {
+		case Camera3D::PROJECTION_PERSPECTIVE:
+			proj = Projection::create_perspective(p_cam->get_fov(), r_aspect, p_cam->get_near(), p_cam->get_far(), flip_fov);
+			break;
+		case Camera3D::PROJECTION_ORTHOGONAL:
+			proj = Projection::create_orthogonal_aspect(p_cam->get_size(), r_aspect, p_cam->get_near(), p_cam->get_far(), flip_fov);
+			break;
+		default:
+			return false;
+	}
+
+	// The camera transform includes `h_offset` and `v_offset`, as in the frustum planes
+	r_view_projection = proj * Projection(p_cam->get_camera_transform().affine_inverse());
+	return true;
+}
+
 void DebugGeometryContainer::update_geometry(double p_delta) {
 	ZoneScoped;
 	LOCK_GUARD(owner->datalock);
@@ -187,13 +233,13 @@ void DebugGeometryContainer::update_geometry(double p_delta) {
 	if (owner->get_config()->is_freeze_3d_render())
 		return;
 
-	if (immediate_mesh_storage.mesh->get_surface_count()) {
-		ZoneScopedN("Clear lines");
-		immediate_mesh_storage.mesh->clear_surfaces();
-	}
-
 	// Return if nothing to do
 	if (!owner->is_debug_enabled()) {
+		if (immediate_mesh_storage.mesh->get_surface_count()) {
+			ZoneScopedN("Clear lines");
+			immediate_mesh_storage.mesh->clear_surfaces();
+		}
+
 		ZoneScopedN("Reset instances");
 		for (auto &item : multi_mesh_storage) {
 			if (item.mesh->get_visible_instance_count())
@@ -220,6 +266,9 @@ void DebugGeometryContainer::update_geometry(double p_delta) {
 		for (const auto &vp_p : available_viewports) {
 			std::vector<std::array<Plane, 6> > frustum_planes;
 			std::vector<AABBMinMax> frustum_boxes;
+			std::vector<GeometryPoolCullingData::ViewCamera> cameras;
+			std::vector<OcclusionBuffer> occlusion_buffers;
+			bool is_occlusion_used = owner->get_config()->is_use_occlusion_culling() && owner->occluder_triangles.size();
 
 			std::vector<std::pair<Array, Camera3D *> > frustum_arrays;
 			frustum_arrays.reserve(1);
@@ -293,6 +342,20 @@ void DebugGeometryContainer::update_geometry(double p_delta) {
 						auto cube = MathUtils::get_frustum_cube(a);
 						AABB aabb = MathUtils::calculate_vertex_bounds(cube.data(), cube.size());
 						frustum_boxes.push_back(aabb);
+						cameras.push_back(_get_view_camera(pair.second));
+
+						if (is_occlusion_used) {
+							Projection view_proj;
+							real_t aspect;
+							if (_get_view_projection(pair.second, view_proj, aspect)) {
+								// The occluders are rasterized later for all cameras at once
+								OcclusionBuffer &buffer = occlusion_buffers.emplace_back();
+								buffer.clear(view_proj, OcclusionBuffer::DEFAULT_WIDTH, (int32_t)Math::round(OcclusionBuffer::DEFAULT_WIDTH / aspect));
+							} else {
+								// An object can only be hidden if it is occluded for all cameras
+								is_occlusion_used = false;
+							}
+						}
 
 #if false
 						// Debug camera bounds
@@ -307,7 +370,30 @@ void DebugGeometryContainer::update_geometry(double p_delta) {
 				}
 			}
 
-			culling_data[vp_p] = std::make_shared<GeometryPoolCullingData>(frustum_planes, frustum_boxes);
+			auto vp_culling_data = std::make_shared<GeometryPoolCullingData>(frustum_planes, frustum_boxes, cameras, owner->get_config()->is_use_lod(), owner->get_config()->get_min_screen_size());
+			if (is_occlusion_used) {
+				vp_culling_data->m_occlusion_buffers = std::move(occlusion_buffers);
+			}
+			culling_data[vp_p] = vp_culling_data;
+		}
+	}
+
+	{
+		ZoneScopedN("Rasterize occluders");
+		// Each camera of each viewport has its own buffer, so they are filled in parallel
+		std::vector<JobPool::Job> jobs;
+		for (auto &p : culling_data) {
+			for (OcclusionBuffer &buffer : p.second->m_occlusion_buffers) {
+				jobs.push_back([this, &buffer](const uint32_t &) {
+					ZoneScopedN("Rasterize occluders for camera");
+					buffer.add_triangles(owner->occluder_triangles.data(), owner->occluder_triangles.size());
+					buffer.build_pyramid();
+				});
+			}
+		}
+
+		if (jobs.size()) {
+			owner->job_pool->run(jobs);
 		}
 	}
 
@@ -331,10 +417,10 @@ void DebugGeometryContainer::update_geometry(double p_delta) {
 			cfg->thickness = 0;
 
 			std::vector<AABBMinMax> new_instances;
-			geometry_pool.for_each_instance([&new_instances](DelayedRendererInstance *o) {
-				if (!o->is_visible || o->is_expired())
+			geometry_pool.for_each_instance([&new_instances](GeometryPoolData3DInstance *, const AABBMinMax &bounds, const bool &is_visible) {
+				if (!is_visible)
 					return;
-				new_instances.push_back(o->bounds);
+				new_instances.push_back(bounds);
 			});
 
 			// Draw custom sphere for 1 frame
@@ -394,18 +480,17 @@ void DebugGeometryContainer::update_geometry(double p_delta) {
 
 			for (const auto &culling_data : culling_data) {
 				for (const auto &frustum : culling_data.second->m_frustums) {
-					size_t s = GeometryGenerator::CubeIndexes.size();
-					std::unique_ptr<Vector3[]> l(new Vector3[s]);
-					GeometryGenerator::CreateCameraFrustumLinesWireframe(frustum, l.get());
+					std::array<Vector3, GeometryGenerator::CubeIndexes.size()> l;
+					GeometryGenerator::CreateCameraFrustumLinesWireframe(frustum, l.data());
 
-					geometry_pool.add_or_update_line(
+					Vector3 *dst = geometry_pool.add_or_update_line(
 							cfg,
 							0,
 							ProcessType::PROCESS,
-							std::move(l),
-							s,
+							l.size(),
 							Colors::red,
-							MathUtils::calculate_vertex_bounds(l.get(), s));
+							MathUtils::calculate_vertex_bounds(l.data(), l.size()));
+					std::copy(l.begin(), l.end(), dst);
 				}
 			}
 		}
@@ -417,7 +502,7 @@ void DebugGeometryContainer::update_geometry(double p_delta) {
 	}
 
 	geometry_pool.reset_visible_objects();
-	geometry_pool.fill_mesh_data(meshes, immediate_mesh_storage.mesh, culling_data);
+	geometry_pool.fill_mesh_data(meshes, immediate_mesh_storage.mesh, culling_data, *owner->job_pool);
 
 	geometry_pool.reset_counter(p_delta, ProcessType::PROCESS);
 
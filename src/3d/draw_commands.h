@@ -0,0 +1,266 @@
+#pragma once
+
+#ifndef DISABLE_DEBUG_RENDERING
+
+#include "config_scope_3d.h"
+#include "render_instances_enums.h"
+#include "utils/math_utils.h"
+#include "utils/utils.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+using namespace godot;
+
+/// @private
+// Instance that is ready to be placed in the GeometryPool.
+// All values that depend on the scoped config are resolved when the command is recorded.
+struct DrawCommandInstance {
+	uint64_t viewport_slot;
+	bool no_depth_test;
+	InstanceType type;
+	ProcessType proc;
+	real_t exp_time;
+	Transform3D transform;
+	Color color;
+	Color custom;
+	SphereBounds bounds;
+
+	DrawCommandInstance() :
+			viewport_slot(DebugDraw3DScopeConfig::Data::NO_VIEWPORT_SLOT),
+			no_depth_test(false),
+			type(InstanceType::MAX),
+			proc(ProcessType::PROCESS),
+			exp_time(0) {}
+};
+
+/// @private
+// The points are stored in DrawThreadContext::line_points in the same order as the commands.
+struct DrawCommandLine {
+	uint64_t viewport_slot;
+	bool no_depth_test;
+	ProcessType proc;
+	real_t exp_time;
+	size_t lines_count;
+	Color color;
+	AABB bounds;
+
+	DrawCommandLine() :
+			viewport_slot(DebugDraw3DScopeConfig::Data::NO_VIEWPORT_SLOT),
+			no_depth_test(false),
+			proc(ProcessType::PROCESS),
+			exp_time(0),
+			lines_count(0) {}
+};
+
+/// @private
+// A series of instances that differ only in position.
+// The positions are stored in DrawThreadContext::point_positions in the same order as the commands.
+struct DrawCommandPoints {
+	uint64_t viewport_slot;
+	bool no_depth_test;
+	InstanceType type;
+	ProcessType proc;
+	real_t exp_time;
+	size_t points_count;
+	real_t scale;
+	real_t bounds_radius;
+	Color color;
+	Color custom;
+
+	DrawCommandPoints() :
+			viewport_slot(DebugDraw3DScopeConfig::Data::NO_VIEWPORT_SLOT),
+			no_depth_test(false),
+			type(InstanceType::MAX),
+			proc(ProcessType::PROCESS),
+			exp_time(0),
+			points_count(0),
+			scale(0),
+			bounds_radius(0) {}
+};
+
+/// @private
+// Single producer, single consumer queue made of linked chunks.
+// The producer only touches the last chunk. The consumer returns the chunks that have already been read to the producer,
+// so the queue stops allocating once it has reached the size needed for a frame.
+template <class T, size_t CHUNK_SIZE = 256>
+class DrawCommandQueue {
+	struct Chunk {
+		std::array<T, CHUNK_SIZE> items;
+		std::atomic<size_t> count;
+		std::atomic<Chunk *> next;
+
+		Chunk() :
+				count(0), next(nullptr) {}
+	};
+
+	// Consumer side
+	Chunk *head;
+	size_t head_read = 0;
+
+	// Producer side
+	Chunk *tail;
+	// Chunks taken from `spare_chunks`, linked by `next`
+	Chunk *free_chunks = nullptr;
+
+	// Consumed chunks linked by `next`. Pushed by the consumer and taken all at once by the producer.
+	std::atomic<Chunk *> spare_chunks;
+
+	static void _delete_chunks(Chunk *p_chunk) {
+		while (p_chunk) {
+			Chunk *next = p_chunk->next.load(std::memory_order_relaxed);
+			delete p_chunk;
+			p_chunk = next;
+		}
+	}
+
+	// Producer side
+	Chunk *_get_free_chunk() {
+		if (!free_chunks) {
+			free_chunks = spare_chunks.exchange(nullptr, std::memory_order_acquire);
+			if (!free_chunks) {
+				return new Chunk();
+			}
+		}
+
+		Chunk *chunk = free_chunks;
+		free_chunks = chunk->next.load(std::memory_order_relaxed);
+		chunk->count.store(0, std::memory_order_relaxed);
+		chunk->next.store(nullptr, std::memory_order_relaxed);
+		return chunk;
+	}
+
+	// Consumer side
+	void _recycle_head() {
+		Chunk *next = head->next.load(std::memory_order_acquire);
+		Chunk *top = spare_chunks.load(std::memory_order_relaxed);
+		do {
+			head->next.store(top, std::memory_order_relaxed);
+		} while (!spare_chunks.compare_exchange_weak(top, head, std::memory_order_release, std::memory_order_relaxed));
+
+		head = next;
+		head_read = 0;
+	}
+
+public:
+	DrawCommandQueue() :
+			spare_chunks(nullptr) {
+		head = tail = new Chunk();
+	}
+
+	~DrawCommandQueue() {
+		_delete_chunks(head);
+		_delete_chunks(free_chunks);
+		_delete_chunks(spare_chunks.load(std::memory_order_acquire));
+	}
+
+	DrawCommandQueue(const DrawCommandQueue &) = delete;
+	DrawCommandQueue &operator=(const DrawCommandQueue &) = delete;
+
+	// Must only be called by the owner thread.
+	void push(T &&p_item) {
+		size_t count = tail->count.load(std::memory_order_relaxed);
+		if (count == CHUNK_SIZE) {
+			Chunk *new_chunk = _get_free_chunk();
+			new_chunk->items[0] = std::move(p_item);
+			new_chunk->count.store(1, std::memory_order_relaxed);
+			tail->next.store(new_chunk, std::memory_order_release);
+			tail = new_chunk;
+			return;
+		}
+
+		tail->items[count] = std::move(p_item);
+		tail->count.store(count + 1, std::memory_order_release);
+	}
+
+	// Must only be called by the owner thread.
+	void push_array(const T *p_items, size_t p_count) {
+		while (p_count) {
+			size_t count = tail->count.load(std::memory_order_relaxed);
+			if (count == CHUNK_SIZE) {
+				Chunk *new_chunk = _get_free_chunk();
+				tail->next.store(new_chunk, std::memory_order_release);
+				tail = new_chunk;
+				count = 0;
+			}
+
+			size_t n = std::min(p_count, CHUNK_SIZE - count);
+			std::copy(p_items, p_items + n, tail->items.begin() + count);
+			tail->count.store(count + n, std::memory_order_release);
+			p_items += n;
+			p_count -= n;
+		}
+	}
+
+	// Must only be called by one thread at a time.
+	// Copies the next `p_count` items to `r_dst` or skips them if `r_dst` is null. The items must have already been pushed.
+	void pop_array(T *r_dst, size_t p_count) {
+		while (p_count) {
+			if (head_read == CHUNK_SIZE) {
+				_recycle_head();
+			}
+
+			size_t n = std::min(p_count, head->count.load(std::memory_order_acquire) - head_read);
+			if (r_dst) {
+				std::copy(head->items.begin() + head_read, head->items.begin() + head_read + n, r_dst);
+				r_dst += n;
+			}
+			head_read += n;
+			p_count -= n;
+		}
+	}
+
+	// Must only be called by one thread at a time.
+	template <class TFunc>
+	void consume(TFunc p_func) {
+		while (true) {
+			size_t count = head->count.load(std::memory_order_acquire);
+			for (; head_read < count; head_read++) {
+				p_func(head->items[head_read]);
+			}
+
+			if (head_read < CHUNK_SIZE) {
+				break;
+			}
+
+			if (!head->next.load(std::memory_order_acquire)) {
+				break;
+			}
+
+			_recycle_head();
+		}
+	}
+};
+
+/// @private
+// Draw calls of a single thread.
+// Recorded without locks by the owner thread and merged into the GeometryPool's once per frame.
+class DrawThreadContext {
+public:
+	const uint64_t thread_id;
+
+	DrawCommandQueue<DrawCommandInstance> instances;
+	DrawCommandQueue<DrawCommandLine> lines;
+	DrawCommandQueue<Vector3, 4096> line_points;
+	DrawCommandQueue<DrawCommandPoints> points;
+	DrawCommandQueue<Vector3, 4096> point_positions;
+
+	// Can be marked by any thread when the list of scoped configs of this thread changes
+	std::atomic_bool is_scoped_config_dirty;
+
+	// Owner thread only
+	std::shared_ptr<DebugDraw3DScopeConfig::Data> scoped_config;
+	// Owner thread only. Reused to generate the points of lines before they are recorded
+	std::vector<Vector3> temp_lines;
+
+	DrawThreadContext(const uint64_t &p_thread_id) :
+			thread_id(p_thread_id),
+			is_scoped_config_dirty(true) {
+		DEV_PRINT_STD("New " NAMEOF(DrawThreadContext) " created for thread %d\n", p_thread_id);
+	}
+};
+
+#endif
@@ -4,133 +4,623 @@
 
 #include "stats_3d.h"
 
+#include <algorithm>
+
 GODOT_WARNING_DISABLE()
 #include <godot_cpp/classes/mesh.hpp>
 #include <godot_cpp/classes/multi_mesh.hpp>
+#include <godot_cpp/classes/project_settings.hpp>
+#include <godot_cpp/classes/rendering_server.hpp>
 GODOT_WARNING_RESTORE()
 
-bool DelayedRenderer::update_visibility(const std::shared_ptr<GeometryPoolCullingData> &p_culling_data) {
-	is_visible = false;
-	for (auto &box : p_culling_data->m_frustum_boxes) {
-		if (box.intersects(bounds)) {
+#ifdef COMPACT_INSTANCES_ENABLED
+bool is_compact_instance_format_supported() {
+	static const bool is_supported = []() {
+		RenderingServer *rs = RenderingServer::get_singleton();
+		String method;
+		// Not available in the API of the older versions of Godot
+		if (rs->has_method("get_current_rendering_method")) {
+			method = rs->call("get_current_rendering_method");
+		} else {
+			method = ProjectSettings::get_singleton()->get_setting_with_override("rendering/renderer/rendering_method");
+		}
+
+		if (method == "gl_compatibility") {
+			PRINT_WARNING("The compact instance format is not supported by the Compatibility renderer. The normal format will be used.");
+			return false;
+		}
+		return true;
+	}();
+	return is_supported;
+}
+
+/// Converts the instances to the MultiMesh format with colors
+static void _unpack_instances(const PackedFloat32Array &p_src, PackedFloat32Array &r_dst) {
+	ZoneScoped;
+	const size_t count = p_src.size() / INSTANCE_DATA_FLOAT_COUNT;
+	if ((size_t)r_dst.size() != count * UNPACKED_INSTANCE_DATA_FLOAT_COUNT) {
+		r_dst.resize(count * UNPACKED_INSTANCE_DATA_FLOAT_COUNT);
+	}
+
+	const float *r = p_src.ptr();
+	float *w = r_dst.ptrw();
+	for (size_t i = 0; i < count; i++) {
+		const float *s = r + i * INSTANCE_DATA_FLOAT_COUNT;
+		float *d = w + i * UNPACKED_INSTANCE_DATA_FLOAT_COUNT;
+		memcpy(d, s, sizeof(float) * 12);
+
+		const Color color = MathUtils::unpack_half4(s[12], s[13]);
+		const Color custom = MathUtils::unpack_half4(s[14], s[15]);
+		d[12] = color.r;
+		d[13] = color.g;
+		d[14] = color.b;
+		d[15] = color.a;
+		d[16] = custom.r;
+		d[17] = custom.g;
+		d[18] = custom.b;
+		d[19] = custom.a;
+	}
+}
+#endif
+
+bool GeometryPoolCullingData::is_visible(const AABBMinMax &p_bounds) const {
+	for (auto &box : m_frustum_boxes) {
+		if (box.intersects(p_bounds)) {
 			goto frustum;
 		}
 	}
-	return is_visible;
+	return false;
 frustum:
-	if (p_culling_data->m_frustums.size()) {
-		for (auto &frustum : p_culling_data->m_frustums) {
-			if (MathUtils::is_bounds_partially_inside_convex_shape(bounds, frustum)) {
-				return is_visible = true;
+	if (m_frustums.size()) {
+		for (auto &frustum : m_frustums) {
+			if (MathUtils::is_bounds_partially_inside_convex_shape(p_bounds, frustum)) {
+				return true;
 			}
 		}
-		return is_visible = false;
+		return false;
 	} else {
-		return is_visible = true;
+		return true;
 	}
 }
 
-DelayedRendererInstance::DelayedRendererInstance() :
-		DelayedRenderer() {
-	DEV_PRINT_STD("New " NAMEOF(DelayedRendererInstance) " created\n");
+bool GeometryPoolCullingData::is_occluded(const AABBMinMax &p_bounds) const {
+	if (m_occlusion_buffers.empty()) {
+		return false;
+	}
+
+	for (const OcclusionBuffer &buffer : m_occlusion_buffers) {
+		if (!buffer.is_occluded(p_bounds)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+real_t GeometryPoolCullingData::get_screen_radius(const Vector3 &p_pos, const real_t &p_radius) const {
+	real_t res = 0;
+	for (const ViewCamera &cam : m_cameras) {
+		if (cam.is_orthogonal) {
+			res = Math::max(res, p_radius * cam.pixels_per_unit);
+			continue;
+		}
+
+		real_t dist = cam.position.distance_to(p_pos);
+		if (dist <= p_radius) {
+			// The camera is inside the sphere
+			return (real_t)INFINITY;
+		}
+		res = Math::max(res, p_radius * cam.pixels_per_unit / dist);
+	}
+	return res;
+}
+
+const InstancesLodChain *InstancesLodChain::get(const InstanceType &p_type) {
+	static const InstancesLodChain sphere_hd = { 4, { InstanceType::SPHERE_HD, InstanceType::SPHERE, InstanceType::SPHERE_LOD1, InstanceType::SPHERE_LOD2 }, { 128, 32, 8 } };
+	static const InstancesLodChain sphere = { 3, { InstanceType::SPHERE, InstanceType::SPHERE_LOD1, InstanceType::SPHERE_LOD2 }, { 32, 8 } };
+	static const InstancesLodChain cylinder = { 2, { InstanceType::CYLINDER, InstanceType::CYLINDER_LOD1 }, { 16 } };
+	static const InstancesLodChain cylinder_ab = { 2, { InstanceType::CYLINDER_AB, InstanceType::CYLINDER_AB_LOD1 }, { 16 } };
+
+	switch (p_type) {
+		case InstanceType::SPHERE_HD:
+			return &sphere_hd;
+		case InstanceType::SPHERE:
+			return &sphere;
+		case InstanceType::CYLINDER:
+			return &cylinder;
+		case InstanceType::CYLINDER_AB:
+			return &cylinder_ab;
+		default:
+			return nullptr;
+	}
+}
+
+bool GeometryPoolCullingData::is_box_visible(const Vector3 &p_min, const Vector3 &p_max) const {
+	for (auto &box : m_frustum_boxes) {
+		if (box.min.x < p_max.x && box.max.x > p_min.x &&
+				box.min.y < p_max.y && box.max.y > p_min.y &&
+				box.min.z < p_max.z && box.max.z > p_min.z) {
+			goto frustum;
+		}
+	}
+	return false;
+frustum:
+	if (m_frustums.size()) {
+		for (auto &frustum : m_frustums) {
+			bool is_inside = true;
+			for (auto &plane : frustum) {
+				// The corner of the box that is furthest behind the plane
+				Vector3 corner(plane.normal.x > 0 ? p_min.x : p_max.x, plane.normal.y > 0 ? p_min.y : p_max.y, plane.normal.z > 0 ? p_min.z : p_max.z);
+				if (plane.distance_to(corner) > 0) {
+					is_inside = false;
+					break;
+				}
+			}
+			if (is_inside) {
+				return true;
+			}
+		}
+		return false;
+	} else {
+		return true;
+	}
+}
+
+bool DelayedRenderer::update_visibility(const GeometryPoolCullingData &p_culling_data) {
+	return is_visible = p_culling_data.is_visible(bounds) && !p_culling_data.is_occluded(bounds);
 }
 
 DelayedRendererLine::DelayedRendererLine() :
 		DelayedRenderer(),
+		lines(nullptr),
 		lines_count(0) {
 	DEV_PRINT_STD("New " NAMEOF(DelayedRendererLine) " created\n");
 }
 
-void GeometryPool::fill_mesh_data(const std::vector<Ref<MultiMesh> *> &p_meshes, Ref<ArrayMesh> p_ig, std::unordered_map<Viewport *, std::shared_ptr<GeometryPoolCullingData> > &p_culling_data) {
+void InstancesStorage::push_back() {
+	bounds_x.emplace_back();
+	bounds_y.emplace_back();
+	bounds_z.emplace_back();
+	bounds_radius.emplace_back();
+	states.emplace_back();
+	data.emplace_back();
+	visible_mask.resize(CullingUtils::get_mask_size(data.size()));
+}
+
+void InstancesStorage::resize(const size_t &p_size) {
+	bounds_x.resize(p_size);
+	bounds_y.resize(p_size);
+	bounds_z.resize(p_size);
+	bounds_radius.resize(p_size);
+	states.resize(p_size);
+	data.resize(p_size);
+	visible_mask.resize(CullingUtils::get_mask_size(p_size));
+}
+
+void InstancesStorage::clear() {
+	bounds_x.clear();
+	bounds_y.clear();
+	bounds_z.clear();
+	bounds_radius.clear();
+	states.clear();
+	data.clear();
+	visible_mask.clear();
+	for (auto &mask : lod_masks) {
+		mask.clear();
+	}
+}
+
+void InstancesStorage::cull(const size_t &p_begin, const size_t &p_end, const GeometryPoolCullingData &p_culling_data) {
+	// p_begin must be a multiple of 64
+	CullingUtils::cull_spheres(bounds_x.data() + p_begin, bounds_y.data() + p_begin, bounds_z.data() + p_begin, bounds_radius.data() + p_begin, p_end - p_begin, p_culling_data.m_volumes, visible_mask.data() + p_begin / 64);
+}
+
+size_t InstancesStorage::cull_occluded(const size_t &p_begin, const size_t &p_end, const GeometryPoolCullingData &p_culling_data) {
+	size_t occluded = 0;
+	size_t last_word = CullingUtils::get_mask_size(p_end);
+	for (size_t w = p_begin / 64; w < last_word; w++) {
+		uint64_t bits = visible_mask[w];
+		if (w == last_word - 1 && (p_end & 63)) {
+			bits &= (1ull << (p_end & 63)) - 1;
+		}
+
+		while (bits) {
+			uint32_t bit = CullingUtils::get_lowest_bit_index(bits);
+			bits &= bits - 1;
+
+			if (p_culling_data.is_occluded(get_bounds(w * 64 + bit))) {
+				visible_mask[w] &= ~(1ull << bit);
+				occluded++;
+			}
+		}
+	}
+	return occluded;
+}
+
+size_t InstancesStorage::apply_screen_size(const size_t &p_begin, const size_t &p_end, const GeometryPoolCullingData &p_culling_data, const InstancesLodChain *p_chain) {
+	size_t last_word = CullingUtils::get_mask_size(p_end);
+	int lods_count = p_chain ? p_chain->count : 1;
+	for (int lod = 1; lod < lods_count; lod++) {
+		auto &mask = lod_masks[lod - 1];
+		std::fill(mask.begin() + p_begin / 64, mask.begin() + last_word, 0);
+	}
+
+	size_t rejected = 0;
+
+	for (size_t w = p_begin / 64; w < last_word; w++) {
+		uint64_t bits = visible_mask[w];
+		if (w == last_word - 1 && (p_end & 63)) {
+			bits &= (1ull << (p_end & 63)) - 1;
+		}
+
+		while (bits) {
+			uint32_t bit = CullingUtils::get_lowest_bit_index(bits);
+			bits &= bits - 1;
+
+			size_t idx = w * 64 + bit;
+			real_t radius = p_culling_data.get_screen_radius(Vector3(bounds_x[idx], bounds_y[idx], bounds_z[idx]), bounds_radius[idx]);
+
+			if (radius < p_culling_data.m_min_screen_radius) {
+				visible_mask[w] &= ~(1ull << bit);
+				rejected++;
+				continue;
+			}
+
+			int lod = 0;
+			while (lod < lods_count - 1 && radius < p_chain->min_screen_radius[lod]) {
+				lod++;
+			}
+
+			if (lod) {
+				visible_mask[w] &= ~(1ull << bit);
+				lod_masks[lod - 1][w] |= 1ull << bit;
+			}
+		}
+	}
+	return rejected;
+}
+
+size_t InstancesStorage::get_visible_count(const size_t &p_begin, const size_t &p_end, const int &p_lod) const {
+	const std::vector<uint64_t> &mask = get_lod_mask(p_lod);
+	size_t res = 0;
+	size_t last_word = CullingUtils::get_mask_size(p_end);
+	for (size_t w = p_begin / 64; w < last_word; w++) {
+		uint64_t bits = mask[w];
+		// Bits after the end of the range
+		if (w == last_word - 1 && (p_end & 63)) {
+			bits &= (1ull << (p_end & 63)) - 1;
+		}
+		res += CullingUtils::get_set_bits_count(bits);
+	}
+	return res;
+}
+
+size_t InstancesStorage::compact_not_expired() {
+	ZoneScoped;
+	size_t dst = 0;
+	for (size_t i = 0; i < states.size(); i++) {
+		if (!states[i].is_expired()) {
+			if (dst != i) {
+				bounds_x[dst] = bounds_x[i];
+				bounds_y[dst] = bounds_y[i];
+				bounds_z[dst] = bounds_z[i];
+				bounds_radius[dst] = bounds_radius[i];
+				states[dst] = states[i];
+				data[dst] = data[i];
+				set_visible(dst, is_visible(i));
+			}
+			dst++;
+		}
+	}
+	return dst;
+}
+
+size_t InstancesStorage::copy_visible_data(const size_t &p_begin, const size_t &p_end, float *p_dst, bool *r_is_changed, const int &p_lod) const {
+	const std::vector<uint64_t> &mask = get_lod_mask(p_lod);
+	const GeometryPoolData3DInstance *src = data.data();
+	size_t run_start = 0;
+	size_t run_size = 0;
+	size_t copied = 0;
+
+	auto copy_run = [&]() {
+		float *dst = p_dst + copied * INSTANCE_DATA_FLOAT_COUNT;
+		const size_t run_bytes = run_size * sizeof(GeometryPoolData3DInstance);
+
+		if (!r_is_changed) {
+			memcpy(dst, src + run_start, run_bytes);
+		} else if (memcmp(dst, src + run_start, run_bytes) != 0) {
+			memcpy(dst, src + run_start, run_bytes);
+			*r_is_changed = true;
+		}
+		copied += run_size;
+	};
+
+	size_t last_word = CullingUtils::get_mask_size(p_end);
+	for (size_t w = p_begin / 64; w < last_word; w++) {
+		uint64_t bits = mask[w];
+		if (w == last_word - 1 && (p_end & 63)) {
+			bits &= (1ull << (p_end & 63)) - 1;
+		}
+
+		// Find runs of set bits
+		while (bits) {
+			uint32_t first = CullingUtils::get_lowest_bit_index(bits);
+			uint64_t shifted = ~(bits >> first);
+			uint32_t length = shifted ? CullingUtils::get_lowest_bit_index(shifted) : 64 - first;
+			size_t idx = w * 64 + first;
+
+			if (run_size && run_start + run_size == idx) {
+				run_size += length;
+			} else {
+				if (run_size) {
+					copy_run();
+				}
+				run_start = idx;
+				run_size = length;
+			}
+
+			bits = first + length >= 64 ? 0 : bits & ~(((1ull << length) - 1) << first);
+		}
+	}
+
+	if (run_size) {
+		copy_run();
+	}
+	return copied;
+}
+
+void GeometryPool::fill_mesh_data(const std::vector<Ref<MultiMesh> *> &p_meshes, Ref<ArrayMesh> p_ig, std::unordered_map<Viewport *, std::shared_ptr<GeometryPoolCullingData> > &p_culling_data, JobPool &p_job_pool) {
 	ZoneScoped;
-	fill_instance_data(p_meshes, p_culling_data);
-	fill_lines_data(p_ig, p_culling_data);
+	update_expiration();
 
-	process_delta_sum = 0;
-	physics_delta_sum = 0;
+	for (auto &vp_pool : pools) {
+		vp_pool->culling_data = p_culling_data[vp_pool->viewport].get();
+	}
+
+	fill_instance_data(p_meshes, p_job_pool);
+	fill_lines_data(p_ig, p_job_pool);
 }
 
-void GeometryPool::fill_instance_data(const std::vector<Ref<MultiMesh> *> &p_meshes, std::unordered_map<Viewport *, std::shared_ptr<GeometryPoolCullingData> > &p_culling_data) {
+void GeometryPool::update_expiration() {
 	ZoneScoped;
+	for (auto &vp_pool : pools) {
+		for (int proc_i = 0; proc_i < (int)ProcessType::MAX; proc_i++) {
+			auto &proc = vp_pool->procs[proc_i];
+			bool is_physics = proc_i == (int)ProcessType::PHYSICS_PROCESS;
+			// The objects are checked against the time of the previous frame, so each object is rendered at least once
+			double time = expiration_times[proc_i];
+			double delta = process_times[proc_i] - time;
+
+			for (auto &i : proc.instances) {
+				i.update_expiration(time, delta, is_physics);
+			}
+			proc.lines.update_expiration(time, delta, is_physics);
+		}
+	}
+
+	std::copy(std::begin(process_times), std::end(process_times), std::begin(expiration_times));
+}
 
-	constexpr size_t INSTANCE_DATA_FLOAT_COUNT = ((sizeof(float) * 3 /*3 components*/ * 4 /*4 vectors3*/ + sizeof(godot::Color) /*Instance Color*/ + sizeof(godot::Color) /*Custom Data*/) / sizeof(float));
+void GeometryPool::fill_instance_data(const std::vector<Ref<MultiMesh> *> &p_meshes, JobPool &p_job_pool) {
+	ZoneScoped;
 
 	// reset timers
 	time_spent_to_cull_instances = 0;
 	time_spent_to_fill_buffers_of_instances = 0;
+	std::fill(time_spent_by_workers.begin(), time_spent_by_workers.end(), 0);
+
+	// Large storages are split so that they can be processed by several workers.
+	// Must be a multiple of 64 to keep the words of the visibility masks separate.
+	constexpr size_t chunk_size = 64 * 256;
+
+	struct Chunk {
+		int type;
+		InstancesPool *pool;
+		InstancesStorage *storage;
+		const DynamicAABBTree *index;
+		const GeometryPoolCullingData *culling_data;
+		size_t begin;
+		size_t end;
+		bool is_delayed;
+		/// Not null if the visible instances are split between the levels of detail
+		const InstancesLodChain *lods;
+
+		// Results
+		size_t not_expired;
+		size_t index_nodes;
+		size_t index_hits;
+		size_t rejected_by_size;
+		size_t occluded;
+		// Results for each level of detail
+		size_t visible[InstancesLodChain::MAX_LODS];
+		size_t offset[InstancesLodChain::MAX_LODS];
+		bool is_changed[InstancesLodChain::MAX_LODS];
+
+		_FORCE_INLINE_ int get_lods_count() const {
+			return lods ? lods->count : 1;
+		}
 
-	for (int type = 0; type < (int)InstanceType::MAX; type++) {
-		ZoneScopedN("Fill iteration");
-		ZoneValue(type);
-		GODOT_STOPWATCH_ADD(&time_spent_to_fill_buffers_of_instances);
+		_FORCE_INLINE_ int get_output_type(const int &p_lod) const {
+			return lods ? (int)lods->types[p_lod] : type;
+		}
+	};
 
-		std::vector<DelayedRendererInstance *> visible_buffer;
-		visible_buffer.reserve(prev_buffer_visible_instance_count[type]);
+	// The data of a chunk at one level of detail, which is copied to the buffer of the type of that level
+	struct ChunkOutput {
+		size_t chunk;
+		int lod;
+	};
 
-		{
-			ZoneScopedN("Update visibility and expiration");
+	std::vector<Chunk> chunks;
+	std::vector<ChunkOutput> type_outputs[(int)InstanceType::MAX];
+
+	{
+		ZoneScopedN("Prepare chunks");
+		GODOT_STOPWATCH_ADD(&time_spent_to_fill_buffers_of_instances);
+		for (int type = 0; type < (int)InstanceType::MAX; type++) {
+			const InstancesLodChain *lod_chain = InstancesLodChain::get((InstanceType)type);
 
 			for (auto &vp_pool : pools) {
-				GODOT_STOPWATCH_ADD(&time_spent_to_cull_instances);
-				auto &culling_data = p_culling_data[vp_pool.first];
+				const GeometryPoolCullingData *culling_data = vp_pool->culling_data;
+				const InstancesLodChain *lods = culling_data->m_is_lod_enabled ? lod_chain : nullptr;
 
 				for (int proc_i = 0; proc_i < (int)ProcessType::MAX; proc_i++) {
-					auto &itype = vp_pool.second[proc_i].instances[type];
+					auto &itype = vp_pool->procs[proc_i].instances[type];
+
+					auto add_chunk = [&](InstancesStorage &p_st, const DynamicAABBTree *p_index, const size_t &p_begin, const size_t &p_end, const bool &p_is_delayed) {
+						Chunk c = {};
+						c.type = type;
+						c.pool = &itype;
+						c.storage = &p_st;
+						c.index = p_index;
+						c.culling_data = culling_data;
+						c.begin = p_begin;
+						c.end = p_end;
+						c.is_delayed = p_is_delayed;
+						c.lods = lods;
+
+						for (int lod = 0; lod < c.get_lods_count(); lod++) {
+							type_outputs[c.get_output_type(lod)].push_back({ chunks.size(), lod });
+						}
+						chunks.push_back(std::move(c));
+					};
 
-					auto &inst_arr = itype.instant;
-					for (int i = 0; i < itype.used_instant; i++) {
-						auto &inst = inst_arr[i];
-						if (inst.update_visibility(culling_data)) {
-							visible_buffer.push_back(&inst);
+					auto add_chunks = [&](InstancesStorage &p_st, const size_t &p_count, const bool &p_is_delayed) {
+						for (size_t begin = 0; begin < p_count; begin += chunk_size) {
+							add_chunk(p_st, nullptr, begin, std::min(begin + chunk_size, p_count), p_is_delayed);
+						}
+					};
+
+					// The masks are resized here, because the chunks of the same storage are processed in parallel
+					for (InstancesStorage *st : { &itype.instant, &itype.delayed }) {
+						for (int lod = 1; lod < InstancesLodChain::MAX_LODS; lod++) {
+							auto &mask = st->lod_masks[lod - 1];
+							if (lods && lod < lods->count) {
+								mask.resize(st->visible_mask.size());
+							} else if (mask.size()) {
+								mask.clear();
+							}
 						}
 					}
 
-					itype.used_delayed = 0;
-					if (proc_i == (int)ProcessType::PHYSICS_PROCESS) {
-						for (auto &inst : itype.delayed) {
-							if (!inst.is_expired()) {
-								if (inst.is_used_one_time) {
-									inst.expiration_time -= physics_delta_sum;
-								}
-								inst.is_used_one_time = true;
-								itype.used_delayed++;
+					add_chunks(itype.instant, itype.used_instant, false);
+					if (itype.is_delayed_index_enabled) {
+						// The index can only be used by one worker
+						add_chunk(itype.delayed, &itype.delayed_index, 0, itype.delayed.size(), true);
+					} else {
+						add_chunks(itype.delayed, itype.delayed.size(), true);
+					}
+				}
+			}
+		}
+	}
 
-								if (inst.update_visibility(culling_data)) {
-									visible_buffer.push_back(&inst);
-								}
+	// Neighboring chunks are combined into one job if they are small
+	auto create_jobs = [&chunks](const std::function<void(Chunk &)> &p_func) {
+		std::vector<JobPool::Job> jobs;
+		size_t first = 0;
+		size_t size = 0;
+		for (size_t i = 0; i < chunks.size(); i++) {
+			size += chunks[i].end - chunks[i].begin;
+			if (size >= chunk_size || i == chunks.size() - 1) {
+				jobs.push_back([&chunks, p_func, first, i](const uint32_t &) {
+					for (size_t c = first; c <= i; c++) {
+						p_func(chunks[c]);
+					}
+				});
+				first = i + 1;
+				size = 0;
+			}
+		}
+		return jobs;
+	};
+
+	{
+		ZoneScopedN("Update visibility and expiration");
+		GODOT_STOPWATCH(&time_spent_to_cull_instances);
+
+		auto jobs = create_jobs([](Chunk &c) {
+			ZoneScopedN("Cull chunk");
+			InstancesStorage &st = *c.storage;
+			if (c.index) {
+				std::fill(st.visible_mask.begin() + c.begin / 64, st.visible_mask.begin() + CullingUtils::get_mask_size(c.end), 0);
+				c.index_nodes = c.index->query(
+						[&c](const Vector3 &p_min, const Vector3 &p_max) { return c.culling_data->is_box_visible(p_min, p_max); },
+						[&c, &st](const uint32_t &p_item) {
+							if (c.culling_data->is_visible(st.get_bounds(p_item))) {
+								st.set_visible(p_item, true);
+								c.index_hits++;
 							}
-						}
+						});
+			} else {
+				st.cull(c.begin, c.end, *c.culling_data);
+			}
+
+			// The expiration is updated before culling, so the states are only read here.
+			// The expired instances are not in the index, so an index chunk takes the count from the free list instead of reading the states.
+			if (c.index) {
+				c.not_expired = c.pool->delayed.size() - c.pool->expiration.get_free_count();
+			} else if (c.is_delayed) {
+				for (size_t i = c.begin; i < c.end; i++) {
+					if (!st.states[i].is_expired()) {
+						c.not_expired++;
 					} else {
-						for (auto &inst : itype.delayed) {
-							if (!inst.is_expired()) {
-								inst.expiration_time -= process_delta_sum;
-								inst.is_used_one_time = true;
-								itype.used_delayed++;
-
-								if (inst.update_visibility(culling_data)) {
-									visible_buffer.push_back(&inst);
-								}
-							}
-						}
+						st.set_visible(i, false);
 					}
 				}
+			}
+
+			if (c.culling_data->m_occlusion_buffers.size()) {
+				c.occluded = st.cull_occluded(c.begin, c.end, *c.culling_data);
+			}
+
+			if (c.lods || c.culling_data->m_min_screen_radius > 0) {
+				c.rejected_by_size = st.apply_screen_size(c.begin, c.end, *c.culling_data, c.lods);
+			}
+
+			for (int lod = 0; lod < c.get_lods_count(); lod++) {
+				c.visible[lod] = st.get_visible_count(c.begin, c.end, lod);
+			}
+		});
+
+		p_job_pool.run(jobs);
+		p_job_pool.add_worker_times(time_spent_by_workers);
+	}
+
+	float *buffers_write[(int)InstanceType::MAX] = {};
+	// The previous content of the buffer is not in the MultiMesh, so there is nothing to compare with
+	bool is_full_upload[(int)InstanceType::MAX] = {};
+
+	{
+		ZoneScopedN("Prepare buffers");
+		GODOT_STOPWATCH_ADD(&time_spent_to_fill_buffers_of_instances);
 
-				stat_visible_instances += visible_buffer.size();
-				prev_buffer_visible_instance_count[type] = visible_buffer.size();
+		for (auto &vp_pool : pools) {
+			for (auto &proc : vp_pool->procs) {
+				for (auto &itype : proc.instances) {
+					itype.used_delayed = 0;
+				}
 			}
 		}
 
-		PackedFloat32Array &buffer = temp_instances_buffers[type];
-		size_t used_buffer_size = visible_buffer.size() * INSTANCE_DATA_FLOAT_COUNT;
+		for (int type = 0; type < (int)InstanceType::MAX; type++) {
+			size_t visible_count = 0;
+			for (const ChunkOutput &o : type_outputs[type]) {
+				Chunk &c = chunks[o.chunk];
+				c.offset[o.lod] = visible_count;
+				visible_count += c.visible[o.lod];
+			}
 
-		{
-			ZoneScopedN("Prepare buffer");
-			ZoneValue(buffer.size());
+			stat_visible_instances += visible_count;
+			prev_buffer_visible_instance_count[type] = visible_count;
+
+			PackedFloat32Array &buffer = temp_instances_buffers[type];
+			size_t used_buffer_size = visible_count * INSTANCE_DATA_FLOAT_COUNT;
 
 			if ((int64_t)used_buffer_size > buffer.size()) {
 				ZoneScopedN("Resize buffer (grew)");
 				ZoneValue(used_buffer_size);
 				buffer.resize(used_buffer_size);
+				is_full_upload[type] = true;
 			}
 
 			// shrink the buffer only if half of it is required.
@@ -138,19 +628,59 @@ void GeometryPool::fill_instance_data(const std::vector<Ref<MultiMesh> *> &p_mes
 				ZoneScopedN("Resize buffer (shrink)");
 				ZoneValue(used_buffer_size);
 				buffer.resize(used_buffer_size);
+				is_full_upload[type] = true;
+			}
+
+			// The MultiMesh was recreated or its buffer was reset
+			if ((int32_t)(buffer.size() / INSTANCE_DATA_FLOAT_COUNT) != (*p_meshes[type])->get_instance_count()) {
+				is_full_upload[type] = true;
+			}
+
+			if (visible_count) {
+				buffers_write[type] = buffer.ptrw();
 			}
 		}
 
-		size_t last_added = 0;
-		{
-			ZoneScopedN("Fill buffer");
-			ZoneValue(visible_buffer.size());
-			auto w = buffer.ptrw();
+		// The same storage can be split into several chunks
+		for (auto &c : chunks) {
+			c.pool->used_delayed += c.not_expired;
+			stat_culling_rejected_by_size += c.rejected_by_size;
+			stat_culling_occluded += c.occluded;
 
-			for (auto &inst : visible_buffer) {
-				memcpy(w + last_added++ * INSTANCE_DATA_FLOAT_COUNT, reinterpret_cast<const float *>(&inst->data), INSTANCE_DATA_FLOAT_COUNT * sizeof(float));
+			if (c.index) {
+				stat_culling_index_nodes += c.index_nodes;
+				stat_culling_index_hits += c.index_hits;
+			} else {
+				stat_culling_linear_checks += c.end - c.begin;
 			}
 		}
+	}
+
+	{
+		ZoneScopedN("Fill buffers");
+		GODOT_STOPWATCH_ADD(&time_spent_to_fill_buffers_of_instances);
+
+		auto jobs = create_jobs([&buffers_write, &is_full_upload](Chunk &c) {
+			for (int lod = 0; lod < c.get_lods_count(); lod++) {
+				if (c.visible[lod]) {
+					ZoneScopedN("Fill chunk");
+					int type = c.get_output_type(lod);
+					c.storage->copy_visible_data(c.begin, c.end, buffers_write[type] + c.offset[lod] * INSTANCE_DATA_FLOAT_COUNT, is_full_upload[type] ? nullptr : &c.is_changed[lod], lod);
+				}
+			}
+		});
+
+		p_job_pool.run(jobs);
+		p_job_pool.add_worker_times(time_spent_by_workers);
+	}
+
+	for (int type = 0; type < (int)InstanceType::MAX; type++) {
+		ZoneScopedN("Update MultiMesh");
+		ZoneValue(type);
+		GODOT_STOPWATCH_ADD(&time_spent_to_fill_buffers_of_instances);
+
+		PackedFloat32Array &buffer = temp_instances_buffers[type];
+		size_t used_buffer_size = prev_buffer_visible_instance_count[type] * INSTANCE_DATA_FLOAT_COUNT;
 
 		// resize if the buffer size has changed.
 		auto &mesh = *p_meshes[type];
@@ -169,27 +699,50 @@ void GeometryPool::fill_instance_data(const std::vector<Ref<MultiMesh> *> &p_mes
 			mesh->set_visible_instance_count(new_visible_count);
 		}
 
-		if (buffer.size()) {
+		if (!buffer.size()) {
+			continue;
+		}
+
+		bool is_changed = is_full_upload[type];
+		for (const ChunkOutput &o : type_outputs[type]) {
+			is_changed |= chunks[o.chunk].is_changed[o.lod];
+		}
+
+		if (!is_changed) {
+			// The GPU already has the same data
+			continue;
+		}
+
+		{
 			ZoneScopedN("Set buffer");
+#ifdef COMPACT_INSTANCES_ENABLED
+			if (!is_compact_instance_format_supported()) {
+				_unpack_instances(buffer, temp_unpacked_instances_buffer);
+				mesh->set_buffer(temp_unpacked_instances_buffer);
+				stat_uploaded_instances_bytes += temp_unpacked_instances_buffer.size() * sizeof(float);
+				continue;
+			}
+#endif
 			mesh->set_buffer(buffer);
+			stat_uploaded_instances_bytes += buffer.size() * sizeof(float);
 		}
 	}
-
-	time_spent_to_fill_buffers_of_instances -= time_spent_to_cull_instances;
 }
 
-void GeometryPool::fill_lines_data(Ref<ArrayMesh> p_ig, std::unordered_map<Viewport *, std::shared_ptr<GeometryPoolCullingData> > &p_culling_data) {
+void GeometryPool::fill_lines_data(Ref<ArrayMesh> p_ig, JobPool &p_job_pool) {
 	ZoneScoped;
 
 	uint64_t used_lines = 0;
 	for (auto &vp_pool : pools) {
-		for (auto &proc : vp_pool.second) {
+		for (auto &proc : vp_pool->procs) {
 			used_lines += proc.lines.used_instant;
 			used_lines += proc.lines.delayed.size();
 		}
 	}
 
 	if (used_lines == 0) {
+		// The lines of the previous frame must be erased
+		_update_lines_surface(p_ig, {}, 0);
 		return;
 	}
 
@@ -197,113 +750,230 @@ void GeometryPool::fill_lines_data(Ref<ArrayMesh> p_ig, std::unordered_map<Viewp
 
 	size_t used_vertexes = 0;
 
-	PackedVector3Array vertexes;
-	PackedColorArray colors;
-
 	std::vector<DelayedRendererLine *> visible_buffer;
 
 	{
 		ZoneScopedN("Prepare buffers");
-		visible_buffer.reserve(prev_buffer_visible_lines_count);
+
+		// Each viewport and process type is culled by its own job. The results are merged in the same order.
+		struct LinesCullResult {
+			std::vector<DelayedRendererLine *> visible;
+			size_t used_vertexes = 0;
+			uint64_t index_nodes = 0;
+			uint64_t index_hits = 0;
+			uint64_t linear_checks = 0;
+		};
+		std::vector<LinesCullResult> results(pools.size() * (int)ProcessType::MAX);
 
 		{
 			ZoneScopedN("Update visibility and expiration");
 			GODOT_STOPWATCH(&time_spent_to_cull_lines);
 
-			// pre calculate buffer size
-
-			for (auto &vp_pool : pools) {
-				auto &culling_data = p_culling_data[vp_pool.first];
-
+			std::vector<JobPool::Job> jobs;
+			for (size_t vp_i = 0; vp_i < pools.size(); vp_i++) {
 				for (int proc_i = 0; proc_i < (int)ProcessType::MAX; proc_i++) {
-					auto &proc = vp_pool.second[proc_i];
-
-					for (size_t i = 0; i < proc.lines.used_instant; i++) {
-						auto &o = proc.lines.instant[i];
-						if (o.update_visibility(culling_data)) {
-							o.is_used_one_time = true;
-							used_vertexes += o.lines_count;
-							visible_buffer.push_back(&o);
-						}
+					ViewportPools *vp_pool = pools[vp_i].get();
+					auto &proc = vp_pool->procs[proc_i];
+					if (proc.lines.used_instant == 0 && proc.lines.delayed.empty()) {
+						proc.lines.used_delayed = 0;
+						continue;
 					}
 
-					proc.lines.used_delayed = 0;
-					if (proc_i == (int)ProcessType::PHYSICS_PROCESS) {
-						for (auto &o : proc.lines.delayed) {
-							if (!o.is_expired()) {
-								if (o.is_used_one_time) {
-									o.expiration_time -= physics_delta_sum;
-								}
-								o.is_used_one_time = true;
-								proc.lines.used_delayed++;
+					LinesCullResult *res = &results[vp_i * (int)ProcessType::MAX + proc_i];
+					jobs.push_back([vp_pool, proc_i, res](const uint32_t &) {
+						ZoneScopedN("Cull lines");
+						const GeometryPoolCullingData &culling_data = *vp_pool->culling_data;
+						auto &proc = vp_pool->procs[proc_i];
 
-								if (o.update_visibility(culling_data)) {
-									used_vertexes += o.lines_count;
-									visible_buffer.push_back(&o);
-								}
+						for (size_t i = 0; i < proc.lines.used_instant; i++) {
+							auto &o = proc.lines.instant[i];
+							if (o.update_visibility(culling_data)) {
+								o.is_used_one_time = true;
+								res->used_vertexes += o.lines_count;
+								res->visible.push_back(&o);
 							}
 						}
-					} else {
-						for (auto &o : proc.lines.delayed) {
-							if (!o.is_expired()) {
-								o.expiration_time -= process_delta_sum;
-								o.is_used_one_time = true;
-								proc.lines.used_delayed++;
-
-								if (o.update_visibility(culling_data)) {
-									used_vertexes += o.lines_count;
-									visible_buffer.push_back(&o);
+						res->linear_checks += proc.lines.used_instant;
+
+						proc.lines.used_delayed = 0;
+						if (proc.lines.is_delayed_index_enabled) {
+							// The expired lines are removed from the index, so only the live lines are visited
+							auto &delayed = proc.lines.delayed;
+							proc.lines.used_delayed = delayed.size() - proc.lines.expiration.get_free_count();
+
+							res->index_nodes += proc.lines.delayed_index.query(
+									[&culling_data](const Vector3 &p_min, const Vector3 &p_max) { return culling_data.is_box_visible(p_min, p_max); },
+									[&culling_data, &delayed, res](const uint32_t &p_item) {
+										auto &o = delayed[p_item];
+										if (culling_data.is_visible(o.bounds) && !culling_data.is_occluded(o.bounds)) {
+											res->index_hits++;
+											res->used_vertexes += o.lines_count;
+											res->visible.push_back(&o);
+										}
+									});
+						} else {
+							res->linear_checks += proc.lines.delayed.size();
+							for (auto &o : proc.lines.delayed) {
+								if (!o.is_expired()) {
+									proc.lines.used_delayed++;
+
+									if (o.update_visibility(culling_data)) {
+										res->used_vertexes += o.lines_count;
+										res->visible.push_back(&o);
+									}
 								}
 							}
 						}
-					}
+					});
 				}
 			}
+
+			p_job_pool.run(jobs);
+			p_job_pool.add_worker_times(time_spent_by_workers);
+		}
+
+		{
+			ZoneScopedN("Merge visible lines");
+			visible_buffer.reserve(prev_buffer_visible_lines_count);
+			for (const LinesCullResult &res : results) {
+				visible_buffer.insert(visible_buffer.end(), res.visible.begin(), res.visible.end());
+				used_vertexes += res.used_vertexes;
+				stat_culling_index_nodes += res.index_nodes;
+				stat_culling_index_hits += res.index_hits;
+				stat_culling_linear_checks += res.linear_checks;
+			}
 		}
 
 		stat_visible_lines = visible_buffer.size();
 		prev_buffer_visible_lines_count = visible_buffer.size();
 
 		ZoneValue(used_vertexes);
-		vertexes.resize(used_vertexes);
-		colors.resize(used_vertexes);
 	}
 
-	size_t prev_pos = 0;
-	auto vertexes_write = vertexes.ptrw();
-	auto colors_write = colors.ptrw();
+	_update_lines_surface(p_ig, visible_buffer, used_vertexes);
 
-	{
-		ZoneScopedN("Fill buffers");
-		ZoneValue(visible_buffer.size());
+	time_spent_to_fill_buffers_of_lines -= time_spent_to_cull_lines;
+}
 
-		for (const auto &o : visible_buffer) {
-			size_t lines_size = o->lines_count;
-			memcpy(vertexes_write + prev_pos, o->lines.get(), o->lines_count * sizeof(Vector3));
-			std::fill(colors_write + prev_pos, colors_write + prev_pos + lines_size, o->color);
-			prev_pos += lines_size;
-		}
+void GeometryPool::_update_lines_surface(Ref<ArrayMesh> p_ig, const std::vector<DelayedRendererLine *> &p_lines, const size_t &p_used_vertexes) {
+	ZoneScoped;
+	LinesSurface &ls = lines_surface;
+	RenderingServer *rs = RenderingServer::get_singleton();
+
+	// The surface was removed by someone else
+	if (!p_ig->get_surface_count()) {
+		ls.capacity = 0;
+		ls.used = 0;
 	}
 
-	if (used_vertexes > 1) {
-		ZoneScopedN("Set mesh arrays");
+	// Nothing to draw and nothing to erase
+	if (p_used_vertexes == 0 && ls.used == 0) {
+		return;
+	}
+
+	size_t new_capacity = ls.capacity;
+	if (p_used_vertexes > ls.capacity) {
+		new_capacity = std::max(std::max(p_used_vertexes, ls.capacity * 2), (size_t)LINES_SURFACE_MIN_CAPACITY);
+	} else if (p_used_vertexes < ls.capacity / 4 && ls.capacity > LINES_SURFACE_MIN_CAPACITY) {
+		// shrink the surface only if less than a quarter of it is required.
+		new_capacity = std::max(p_used_vertexes * 2, (size_t)LINES_SURFACE_MIN_CAPACITY);
+	}
+
+	if (new_capacity != ls.capacity) {
+		ZoneScopedN("Create lines surface");
+		ZoneValue(new_capacity);
+
+		// All vertexes are at the origin, so the new surface draws nothing
+		PackedVector3Array vertexes;
+		vertexes.resize(new_capacity);
+		PackedColorArray colors;
+		colors.resize(new_capacity);
 
 		Array mesh = Array();
 		mesh.resize(ArrayMesh::ArrayType::ARRAY_MAX);
 		mesh[ArrayMesh::ArrayType::ARRAY_VERTEX] = vertexes;
 		mesh[ArrayMesh::ArrayType::ARRAY_COLOR] = colors;
 
+		p_ig->clear_surfaces();
 		p_ig->add_surface_from_arrays(Mesh::PrimitiveType::PRIMITIVE_LINES, mesh);
+
+		BitField<RenderingServer::ArrayFormat> format = (int64_t)p_ig->surface_get_format(0);
+		ls.capacity = new_capacity;
+		ls.used = 0;
+		ls.vertex_stride = rs->mesh_surface_get_format_vertex_stride(format, (int32_t)new_capacity);
+		ls.attribute_stride = rs->mesh_surface_get_format_attribute_stride(format, (int32_t)new_capacity);
+		ls.color_offset = rs->mesh_surface_get_format_offset(format, (int32_t)new_capacity, RenderingServer::ARRAY_COLOR);
+		ls.aabb = AABB();
 	}
 
-	time_spent_to_fill_buffers_of_lines -= time_spent_to_cull_lines;
+	// The vertexes of the previous frame that are no longer used must be collapsed too
+	const size_t update_count = std::max(p_used_vertexes, ls.used);
+	ls.vertexes.resize(update_count * ls.vertex_stride);
+	ls.attributes.resize(update_count * ls.attribute_stride);
+
+	Vector3 aabb_min;
+	Vector3 aabb_max;
+	size_t pos = 0;
+
+	{
+		ZoneScopedN("Fill buffers");
+		ZoneValue(p_lines.size());
+
+		uint8_t *vertexes_write = ls.vertexes.ptrw();
+		uint8_t *attributes_write = ls.attributes.ptrw();
+
+		for (const auto &o : p_lines) {
+			// The same conversion as in RenderingServer
+			const uint8_t color[4] = {
+				(uint8_t)CLAMP(o->color.r * 255.0, 0.0, 255.0),
+				(uint8_t)CLAMP(o->color.g * 255.0, 0.0, 255.0),
+				(uint8_t)CLAMP(o->color.b * 255.0, 0.0, 255.0),
+				(uint8_t)CLAMP(o->color.a * 255.0, 0.0, 255.0),
+			};
+
+			for (size_t i = 0; i < o->lines_count; i++) {
+				const Vector3 &v = o->lines[i];
+				float *dst = (float *)(vertexes_write + pos * ls.vertex_stride);
+				dst[0] = (float)v.x;
+				dst[1] = (float)v.y;
+				dst[2] = (float)v.z;
+				memcpy(attributes_write + pos * ls.attribute_stride + ls.color_offset, color, sizeof(color));
+
+				if (pos) {
+					aabb_min = aabb_min.min(v);
+					aabb_max = aabb_max.max(v);
+				} else {
+					aabb_min = aabb_max = v;
+				}
+				pos++;
+			}
+		}
+
+		memset(vertexes_write + pos * ls.vertex_stride, 0, (update_count - pos) * ls.vertex_stride);
+		memset(attributes_write + pos * ls.attribute_stride, 0, (update_count - pos) * ls.attribute_stride);
+	}
+
+	if (update_count) {
+		ZoneScopedN("Update lines surface");
+		ZoneValue(update_count);
+		rs->mesh_surface_update_vertex_region(p_ig->get_rid(), 0, 0, ls.vertexes);
+		rs->mesh_surface_update_attribute_region(p_ig->get_rid(), 0, 0, ls.attributes);
+	}
+	ls.used = p_used_vertexes;
+
+	// The surface is not recalculated by the server, so it needs the bounds of the lines to be culled correctly
+	AABB aabb = pos ? AABB(aabb_min, aabb_max - aabb_min) : AABB();
+	if (aabb != ls.aabb) {
+		ls.aabb = aabb;
+		p_ig->set_custom_aabb(aabb);
+	}
 }
 
 void GeometryPool::reset_counter(const double &p_delta, const ProcessType &p_proc) {
 	ZoneScoped;
 	if (p_proc == ProcessType::MAX) {
 		for (auto &vp_pool : pools) {
-			for (auto &proc : vp_pool.second) {
+			for (auto &proc : vp_pool->procs) {
 				for (int i = 0; i < (int)InstanceType::MAX; i++) {
 					proc.instances[i].reset_counter(p_delta, i);
 				}
@@ -312,7 +982,7 @@ void GeometryPool::reset_counter(const double &p_delta, const ProcessType &p_pro
 		}
 	} else {
 		for (auto &vp_pool : pools) {
-			auto &proc = vp_pool.second[(int)p_proc];
+			auto &proc = vp_pool->procs[(int)p_proc];
 			for (int i = 0; i < (int)InstanceType::MAX; i++) {
 				proc.instances[i].reset_counter(p_delta, i);
 			}
@@ -325,6 +995,12 @@ void GeometryPool::reset_visible_objects() {
 	ZoneScoped;
 	stat_visible_instances = 0;
 	stat_visible_lines = 0;
+	stat_culling_index_nodes = 0;
+	stat_culling_index_hits = 0;
+	stat_culling_linear_checks = 0;
+	stat_culling_rejected_by_size = 0;
+	stat_culling_occluded = 0;
+	stat_uploaded_instances_bytes = 0;
 }
 
 void GeometryPool::set_stats(Ref<DebugDraw3DStats> &p_stats) const {
@@ -337,7 +1013,7 @@ void GeometryPool::set_stats(Ref<DebugDraw3DStats> &p_stats) const {
 
 	for (auto &vp_pool : pools) {
 		for (int proc_i = 0; proc_i < (int)ProcessType::MAX; proc_i++) {
-			auto &proc = vp_pool.second[proc_i];
+			auto &proc = vp_pool->procs[proc_i];
 			for (auto &i : proc.instances) {
 				counts[proc_i].used_instances += i._prev_used_instant;
 				counts[proc_i].used_instances += i.used_delayed;
@@ -364,12 +1040,21 @@ void GeometryPool::set_stats(Ref<DebugDraw3DStats> &p_stats) const {
 
 			/* t_time_culling_instances_usec */ time_spent_to_cull_instances,
 			/* t_time_culling_lines_usec */ time_spent_to_cull_lines);
+
+	PackedInt64Array workers_times;
+	workers_times.resize(time_spent_by_workers.size());
+	for (size_t i = 0; i < time_spent_by_workers.size(); i++) {
+		workers_times[i] = time_spent_by_workers[i];
+	}
+	p_stats->set_workers_stats(workers_times);
+	p_stats->set_culling_index_stats(stat_culling_index_nodes, stat_culling_index_hits, stat_culling_linear_checks, stat_culling_rejected_by_size, stat_culling_occluded);
+	p_stats->set_upload_stats(stat_uploaded_instances_bytes);
 }
 
 void GeometryPool::clear_pool() {
 	ZoneScoped;
 	for (auto &vp_pool : pools) {
-		for (auto &proc : vp_pool.second) {
+		for (auto &proc : vp_pool->procs) {
 			for (auto &i : proc.instances) {
 				i.clear_pools();
 			}
@@ -378,17 +1063,17 @@ void GeometryPool::clear_pool() {
 	}
 }
 
-void GeometryPool::for_each_instance(const std::function<void(DelayedRendererInstance *)> &p_func) {
+void GeometryPool::for_each_instance(const std::function<void(GeometryPoolData3DInstance *, const AABBMinMax &, const bool &)> &p_func) {
 	ZoneScoped;
 	for (auto &vp_pool : pools) {
-		for (auto &proc : vp_pool.second) {
+		for (auto &proc : vp_pool->procs) {
 			for (auto &inst : proc.instances) {
 				for (size_t i = 0; i < inst.used_instant; i++) {
-					p_func(&inst.instant[i]);
+					p_func(&inst.instant.data[i], inst.instant.get_bounds(i), inst.instant.is_visible_at_any_lod(i));
 				}
 				for (size_t i = 0; i < inst.delayed.size(); i++) {
-					if (!inst.delayed[i].is_expired())
-						p_func(&inst.delayed[i]);
+					if (!inst.delayed.states[i].is_expired())
+						p_func(&inst.delayed.data[i], inst.delayed.get_bounds(i), inst.delayed.is_visible_at_any_lod(i));
 				}
 			}
 		}
@@ -398,7 +1083,7 @@ void GeometryPool::for_each_instance(const std::function<void(DelayedRendererIns
 void GeometryPool::for_each_line(const std::function<void(DelayedRendererLine *)> &p_func) {
 	ZoneScoped;
 	for (auto &vp_pool : pools) {
-		for (auto &proc : vp_pool.second) {
+		for (auto &proc : vp_pool->procs) {
 			for (size_t i = 0; i < proc.lines.used_instant; i++) {
 				p_func(&proc.lines.instant[i]);
 			}
@@ -413,15 +1098,11 @@ void GeometryPool::for_each_line(const std::function<void(DelayedRendererLine *)
 void GeometryPool::update_expiration_delta(const double &p_delta, const ProcessType &p_proc) {
 	ZoneScoped;
 
-	if (p_proc == ProcessType::PHYSICS_PROCESS) {
-		physics_delta_sum += p_delta;
-	} else {
-		process_delta_sum += p_delta;
-	}
+	process_times[(int)p_proc] += p_delta;
 }
 
-bool GeometryPool::_is_viewport_empty(Viewport *vp) {
-	for (auto &proc : pools[vp]) {
+bool GeometryPool::_is_viewport_empty(const ViewportPools &p_vp_pool) const {
+	for (auto &proc : p_vp_pool.procs) {
 		for (auto &i : proc.instances) {
 			if (i.instant.size() || i.delayed.size()) {
 				return false;
@@ -434,6 +1115,42 @@ bool GeometryPool::_is_viewport_empty(Viewport *vp) {
 	return true;
 }
 
+GeometryPool::processTypePools *GeometryPool::_get_viewport_pools(const uint64_t &p_slot, Viewport *p_vp, const uint64_t &p_vp_id) {
+	const uint32_t slot_idx = (uint32_t)p_slot;
+	const uint32_t slot_gen = (uint32_t)(p_slot >> 32);
+	const bool has_slot = p_slot != DebugDraw3DScopeConfig::Data::NO_VIEWPORT_SLOT && slot_idx < DebugDraw3DScopeConfig::Data::MAX_VIEWPORT_SLOTS;
+
+	if (has_slot && slot_idx < slot_pools.size()) {
+		const SlotPools &s = slot_pools[slot_idx];
+		if (s.pools && s.generation == slot_gen) {
+			return s.pools;
+		}
+	}
+
+	ViewportPools *vp_pool = nullptr;
+	for (auto &p : pools) {
+		if (p->viewport == p_vp) {
+			vp_pool = p.get();
+			break;
+		}
+	}
+
+	if (!vp_pool) {
+		vp_pool = pools.emplace_back(std::make_unique<ViewportPools>()).get();
+		vp_pool->viewport = p_vp;
+	}
+	vp_pool->viewport_id = p_vp_id;
+	processTypePools *res = vp_pool->procs;
+
+	if (has_slot) {
+		if (slot_idx >= slot_pools.size()) {
+			slot_pools.resize((size_t)slot_idx + 1);
+		}
+		slot_pools[slot_idx] = { slot_gen, res };
+	}
+	return res;
+}
+
 void GeometryPool::set_no_depth_test_info(bool p_no_depth_test) {
 	is_no_depth_test = p_no_depth_test;
 }
@@ -441,24 +1158,27 @@ void GeometryPool::set_no_depth_test_info(bool p_no_depth_test) {
 std::vector<Viewport *> GeometryPool::get_and_validate_viewports() {
 	ZoneScoped;
 	std::vector<Viewport *> res;
-	std::vector<Viewport *> to_delete;
+	size_t prev_size = pools.size();
 
-	for (const auto &vp : viewport_ids) {
-		if (UtilityFunctions::is_instance_id_valid(vp.second)) {
-			if (_is_viewport_empty(vp.first)) {
-				DEV_PRINT_STD("%s Viewport (%s) did not contain any debug data,\n\tit will be deleted from the World3D's container.\n", is_no_depth_test ? "NoDepth" : "Normal", vp.first->to_string().utf8().get_data());
-				to_delete.push_back(vp.first);
-			} else {
-				res.push_back(vp.first);
-			}
-		} else {
-			to_delete.push_back(vp.first);
+	auto it = std::remove_if(pools.begin(), pools.end(), [this](const std::unique_ptr<ViewportPools> &p_vp_pool) {
+		if (!UtilityFunctions::is_instance_id_valid(p_vp_pool->viewport_id)) {
+			return true;
+		}
+		if (_is_viewport_empty(*p_vp_pool)) {
+			DEV_PRINT_STD("%s Viewport (%s) did not contain any debug data,\n\tit will be deleted from the World3D's container.\n", is_no_depth_test ? "NoDepth" : "Normal", p_vp_pool->viewport->to_string().utf8().get_data());
+			return true;
 		}
+		return false;
+	});
+	pools.erase(it, pools.end());
+
+	for (const auto &vp_pool : pools) {
+		res.push_back(vp_pool->viewport);
 	}
 
-	for (const auto &vp : to_delete) {
-		viewport_ids.erase(vp);
-		pools.erase(vp);
+	// The cached pointers may point to the erased pools
+	if (pools.size() != prev_size) {
+		slot_pools.clear();
 	}
 
 	return res;
@@ -471,33 +1191,131 @@ void GeometryPool::add_or_update_instance(const std::shared_ptr<DebugDraw3DScope
 
 void GeometryPool::add_or_update_instance(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg, InstanceType p_type, const real_t &p_exp_time, const ProcessType &p_proc, const Transform3D &p_transform, const Color &p_col, const SphereBounds &p_bounds, const Color *p_custom_col) {
 	ZoneScoped;
-	auto &proc = pools[p_cfg->dcd.viewport][(int)p_proc];
-	DelayedRendererInstance *inst = proc.instances[(int)p_type].get(p_exp_time > 0);
-	viewport_ids[p_cfg->dcd.viewport] = p_cfg->dcd.viewport->get_instance_id();
-
 	SphereBounds thick_sphere = p_bounds;
 	thick_sphere.radius += p_cfg->thickness * 0.5f;
 
-	inst->data = GeometryPoolData3DInstance(p_transform, p_col, p_custom_col ? *p_custom_col : _scoped_config_to_custom(p_cfg));
-	inst->bounds = thick_sphere;
-	inst->expiration_time = p_exp_time;
-	inst->is_used_one_time = false;
-	inst->is_visible = true;
+	add_or_update_instance(DebugDraw3DScopeConfig::Data::NO_VIEWPORT_SLOT, p_cfg->dcd.viewport, p_cfg->dcd.viewport->get_instance_id(), p_type, p_exp_time, p_proc, p_transform, p_col, p_custom_col ? *p_custom_col : _scoped_config_to_custom(p_cfg), thick_sphere);
+}
+
+void GeometryPool::add_or_update_instance(const uint64_t &p_vp_slot, Viewport *p_vp, const uint64_t &p_vp_id, InstanceType p_type, const real_t &p_exp_time, const ProcessType &p_proc, const Transform3D &p_transform, const Color &p_col, const Color &p_custom_col, const SphereBounds &p_bounds) {
+	ZoneScoped;
+	auto &pool = _get_viewport_pools(p_vp_slot, p_vp, p_vp_id)[(int)p_proc].instances[(int)p_type];
+	bool is_delayed = p_exp_time > 0;
+	size_t idx = pool.get(is_delayed);
+	InstancesStorage &st = is_delayed ? pool.delayed : pool.instant;
+
+	st.data[idx] = GeometryPoolData3DInstance(p_transform, p_col, p_custom_col);
+	st.set_bounds(idx, p_bounds);
+	st.set_visible(idx, true);
+	if (is_delayed) {
+		pool.update_delayed_index(idx);
+		pool.set_expiration(idx, _get_deadline(p_proc, p_exp_time));
+	} else {
+		auto &state = st.states[idx];
+		state.expiration_time = p_exp_time;
+		state.is_used_one_time = false;
+	}
+}
+
+void GeometryPool::add_points(const uint64_t &p_vp_slot, Viewport *p_vp, const uint64_t &p_vp_id, InstanceType p_type, const real_t &p_exp_time, const ProcessType &p_proc, const Vector3 *p_points, const size_t &p_count, const real_t &p_scale, const real_t &p_bounds_radius, const Color &p_col, const Color &p_custom_col, const Vector3 &p_origin_offset) {
+	ZoneScoped;
+	ZoneValue(p_count);
+	auto &pool = _get_viewport_pools(p_vp_slot, p_vp, p_vp_id)[(int)p_proc].instances[(int)p_type];
+
+	// All points share everything except the position
+	GeometryPoolData3DInstance base(Transform3D(Basis().scaled(VEC3_ONE(p_scale)), Vector3()), p_col, p_custom_col);
+
+	if (p_exp_time > 0) {
+		// Delayed slots are reused one by one, because the expired ones are scattered across the storage
+		InstancesStorage &st = pool.delayed;
+		for (size_t i = 0; i < p_count; i++) {
+			size_t idx = pool.get(true);
+			const Vector3 pos = p_points[i];
+			const Vector3 origin = pos - p_origin_offset;
+
+			GeometryPoolData3DInstance &d = st.data[idx];
+			d = base;
+			d.origin_x = (float)origin.x;
+			d.origin_y = (float)origin.y;
+			d.origin_z = (float)origin.z;
+			st.set_bounds(idx, SphereBounds(pos, p_bounds_radius));
+			st.set_visible(idx, true);
+			pool.update_delayed_index(idx);
+			pool.set_expiration(idx, _get_deadline(p_proc, p_exp_time));
+		}
+		return;
+	}
+
+	InstancesStorage &st = pool.instant;
+	const size_t begin = pool.get_instant_range(p_count);
+
+	// Each array is filled by a separate simple loop, so the compiler can vectorize them
+	{
+		real_t *bx = st.bounds_x.data() + begin;
+		real_t *by = st.bounds_y.data() + begin;
+		real_t *bz = st.bounds_z.data() + begin;
+		for (size_t i = 0; i < p_count; i++) {
+			bx[i] = p_points[i].x;
+			by[i] = p_points[i].y;
+			bz[i] = p_points[i].z;
+		}
+		std::fill_n(st.bounds_radius.data() + begin, p_count, p_bounds_radius);
+	}
+
+	{
+		GeometryPoolData3DInstance *data = st.data.data() + begin;
+		for (size_t i = 0; i < p_count; i++) {
+			const Vector3 origin = p_points[i] - p_origin_offset;
+			data[i] = base;
+			data[i].origin_x = (float)origin.x;
+			data[i].origin_y = (float)origin.y;
+			data[i].origin_z = (float)origin.z;
+		}
+	}
+
+	InstancesStorage::State state;
+	state.expiration_time = p_exp_time;
+	state.is_used_one_time = false;
+	std::fill_n(st.states.data() + begin, p_count, state);
+
+	for (size_t i = begin; i < begin + p_count; i++) {
+		st.set_visible(i, true);
+	}
 }
 
-void GeometryPool::add_or_update_line(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg, const real_t &p_exp_time, const ProcessType &p_proc, std::unique_ptr<Vector3[]> p_lines, const size_t p_line_count, const Color &p_col, const AABB &p_aabb) {
+Vector3 *GeometryPool::add_or_update_line(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg, const real_t &p_exp_time, const ProcessType &p_proc, const size_t p_line_count, const Color &p_col, const AABB &p_aabb) {
 	ZoneScoped;
-	auto &proc = pools[p_cfg->dcd.viewport][(int)p_proc];
-	DelayedRendererLine *inst = proc.lines.get(p_exp_time > 0);
-	viewport_ids[p_cfg->dcd.viewport] = p_cfg->dcd.viewport->get_instance_id();
+	return add_or_update_line(DebugDraw3DScopeConfig::Data::NO_VIEWPORT_SLOT, p_cfg->dcd.viewport, p_cfg->dcd.viewport->get_instance_id(), p_exp_time, p_proc, p_line_count, p_col, p_aabb);
+}
 
-	inst->lines = std::move(p_lines);
+Vector3 *GeometryPool::add_or_update_line(const uint64_t &p_vp_slot, Viewport *p_vp, const uint64_t &p_vp_id, const real_t &p_exp_time, const ProcessType &p_proc, const size_t p_line_count, const Color &p_col, const AABB &p_aabb) {
+	ZoneScoped;
+	auto &proc = _get_viewport_pools(p_vp_slot, p_vp, p_vp_id)[(int)p_proc];
+	bool is_delayed = p_exp_time > 0;
+	DelayedRendererLine *inst = proc.lines.get(is_delayed);
+
+	if (is_delayed) {
+		// The block of an expired line is reused if its size is close enough
+		size_t block_size = inst->delayed_block.size();
+		if (block_size < p_line_count || block_size > p_line_count * 4) {
+			inst->delayed_block = proc.lines.delayed_points.allocate(p_line_count);
+		}
+		inst->lines = inst->delayed_block.get();
+	} else {
+		inst->lines = proc.lines.instant_points.allocate(p_line_count);
+	}
 	inst->lines_count = p_line_count;
 	inst->color = p_col;
 	inst->bounds = p_aabb;
-	inst->expiration_time = p_exp_time;
-	inst->is_used_one_time = false;
 	inst->is_visible = true;
+	if (is_delayed) {
+		proc.lines.update_delayed_index(inst);
+		proc.lines.set_expiration(inst, _get_deadline(p_proc, p_exp_time));
+	} else {
+		inst->expiration_time = p_exp_time;
+		inst->is_used_one_time = false;
+	}
+	return inst->lines;
 }
 
 GeometryType GeometryPool::_scoped_config_get_geometry_type(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg) {
@@ -2,9 +2,16 @@
 
 #ifndef DISABLE_DEBUG_RENDERING
 
+#include "common/frame_arena.h"
+#include "common/slab_allocator.h"
 #include "config_scope_3d.h"
 #include "render_instances_enums.h"
+#include "utils/dynamic_aabb_tree.h"
+#include "utils/expiration_queue.h"
+#include "utils/job_pool.h"
 #include "utils/math_utils.h"
+#include "utils/occlusion_buffer.h"
+#include "utils/simd_culling.h"
 #include "utils/utils.h"
 
 #include <array>
@@ -24,12 +31,54 @@ class GeometryPool;
 
 class GeometryPoolCullingData {
 public:
+	/// Camera used to find the size of the objects on the screen
+	struct ViewCamera {
+		Vector3 position;
+		/// Pixels per unit at a distance of 1 for perspective cameras or at any distance for orthogonal cameras
+		real_t pixels_per_unit;
+		bool is_orthogonal;
+	};
+
 	std::vector<std::array<Plane, 6> > m_frustums;
 	std::vector<AABBMinMax> m_frustum_boxes;
-	GeometryPoolCullingData(const std::vector<std::array<Plane, 6> > &p_frustums, const std::vector<AABBMinMax> p_frustum_boxes) {
+	CullingVolumes m_volumes;
+	std::vector<ViewCamera> m_cameras;
+	bool m_is_lod_enabled;
+	/// Instances with a smaller radius in pixels are not drawn. Zero if disabled.
+	real_t m_min_screen_radius;
+	/// One buffer for each camera or empty if the occlusion culling is disabled.
+	std::vector<OcclusionBuffer> m_occlusion_buffers;
+
+	GeometryPoolCullingData(const std::vector<std::array<Plane, 6> > &p_frustums, const std::vector<AABBMinMax> p_frustum_boxes, const std::vector<ViewCamera> &p_cameras = {}, const bool &p_is_lod_enabled = false, const real_t &p_min_screen_size = 0) :
+			m_volumes(p_frustum_boxes, p_frustums) {
 		m_frustums = p_frustums;
 		m_frustum_boxes = p_frustum_boxes;
+		m_cameras = p_cameras;
+		m_is_lod_enabled = p_is_lod_enabled && p_cameras.size();
+		m_min_screen_radius = p_cameras.size() ? p_min_screen_size * 0.5f : 0;
 	}
+
+	_FORCE_INLINE_ bool is_visible(const AABBMinMax &p_bounds) const;
+	/// Conservative check for the nodes of DynamicAABBTree.
+	_FORCE_INLINE_ bool is_box_visible(const Vector3 &p_min, const Vector3 &p_max) const;
+	/// Returns true if the bounds are hidden by the occluders for all cameras.
+	_FORCE_INLINE_ bool is_occluded(const AABBMinMax &p_bounds) const;
+	/// Returns the largest radius of the sphere in pixels among all cameras.
+	_FORCE_INLINE_ real_t get_screen_radius(const Vector3 &p_pos, const real_t &p_radius) const;
+};
+
+/// Types used to render the instances of a type when they become smaller on the screen.
+/// The first level is the type itself.
+struct InstancesLodChain {
+	static constexpr int MAX_LODS = 4;
+
+	int count;
+	InstanceType types[MAX_LODS];
+	/// The minimum radius in pixels of each level except the last one
+	real_t min_screen_radius[MAX_LODS - 1];
+
+	/// Returns nullptr if the type has only one level of detail
+	static const InstancesLodChain *get(const InstanceType &p_type);
 };
 
 struct GeometryPoolData3DInstance {
@@ -39,8 +88,17 @@ struct GeometryPoolData3DInstance {
 	float origin_y;
 	Vector3Float basis_z;
 	float origin_z;
+#ifdef COMPACT_INSTANCES_ENABLED
+	// The color and the custom data are stored as half floats in the custom data of MultiMesh.
+	// They are unpacked by the shaders with `unpackHalf2x16`.
+	uint32_t color_rg;
+	uint32_t color_ba;
+	uint32_t custom_xy;
+	uint32_t custom_zw;
+#else
 	Color color;
 	Color custom;
+#endif
 
 	GeometryPoolData3DInstance() :
 			basis_x(),
@@ -49,8 +107,15 @@ struct GeometryPoolData3DInstance {
 			origin_y(0),
 			basis_z(),
 			origin_z(0),
+#ifdef COMPACT_INSTANCES_ENABLED
+			color_rg(0),
+			color_ba(0),
+			custom_xy(0),
+			custom_zw(0) {}
+#else
 			color(Color()),
 			custom(Color()) {}
+#endif
 
 	GeometryPoolData3DInstance(const Transform3D &p_xf, const Color &p_color, const Color &p_custom) :
 			basis_x(p_xf.basis[0]),
@@ -59,49 +124,165 @@ struct GeometryPoolData3DInstance {
 			origin_y((float)p_xf.origin.y),
 			basis_z(p_xf.basis[2]),
 			origin_z((float)p_xf.origin.z),
+#ifdef COMPACT_INSTANCES_ENABLED
+			color_rg(MathUtils::pack_half2(p_color.r, p_color.g)),
+			color_ba(MathUtils::pack_half2(p_color.b, p_color.a)),
+			custom_xy(MathUtils::pack_half2(p_custom.r, p_custom.g)),
+			custom_zw(MathUtils::pack_half2(p_custom.b, p_custom.a)) {}
+#else
 			color(p_color),
 			custom(p_custom) {}
+#endif
 };
 
+#ifdef COMPACT_INSTANCES_ENABLED
+constexpr size_t INSTANCE_DATA_FLOAT_COUNT = ((sizeof(float) * 3 /*3 components*/ * 4 /*4 vectors3*/ + sizeof(uint32_t) * 4 /*Packed Color and Custom Data*/) / sizeof(float));
+#else
+constexpr size_t INSTANCE_DATA_FLOAT_COUNT = ((sizeof(float) * 3 /*3 components*/ * 4 /*4 vectors3*/ + sizeof(godot::Color) /*Instance Color*/ + sizeof(godot::Color) /*Custom Data*/) / sizeof(float));
+#endif
+static_assert(sizeof(GeometryPoolData3DInstance) == INSTANCE_DATA_FLOAT_COUNT * sizeof(float), "GeometryPoolData3DInstance must match the MultiMesh buffer layout");
+
+#ifdef COMPACT_INSTANCES_ENABLED
+/// Transform, color and custom data as floats, as in the MultiMesh buffer with colors
+constexpr size_t UNPACKED_INSTANCE_DATA_FLOAT_COUNT = 12 + 4 + 4;
+
+/// The Compatibility renderer converts the color and the custom data of MultiMesh to half floats when uploading them,
+/// which destroys the packed values. With this renderer, the instances are unpacked to the normal MultiMesh format,
+/// MultiMesh colors are used and the shaders are built without `COMPACT_INSTANCE`.
+bool is_compact_instance_format_supported();
+#endif
+
 struct DelayedRenderer {
+	static constexpr double EXPIRED = -1;
+
+	/// Deadline on the clock of the ProcessType for the delayed objects
 	double expiration_time;
 	bool is_used_one_time;
 	bool is_visible;
 	AABBMinMax bounds;
+	int32_t index_leaf;
 
 	DelayedRenderer() :
 			expiration_time(0),
 			is_used_one_time(true),
 			is_visible(false),
-			bounds() {}
+			bounds(),
+			index_leaf(DynamicAABBTree::NULL_NODE) {}
 
 	_FORCE_INLINE_ bool is_expired() const {
-		return expiration_time < 0 ? is_used_one_time : false;
+		return expiration_time < 0;
 	}
 
-	_FORCE_INLINE_ void update_viewport_expiration(const double &p_delta) {
-		if (!is_expired()) {
-			expiration_time -= p_delta;
-		}
-	}
-
-	_FORCE_INLINE_ bool update_visibility(const std::shared_ptr<GeometryPoolCullingData> &p_culling_data);
-};
-
-struct DelayedRendererInstance : public DelayedRenderer {
-	GeometryPoolData3DInstance data;
-
-	DelayedRendererInstance();
+	_FORCE_INLINE_ bool update_visibility(const GeometryPoolCullingData &p_culling_data);
 };
 
 struct DelayedRendererLine : public DelayedRenderer {
-	std::unique_ptr<Vector3[]> lines;
+	// Points are stored in the FrameArena of the pool for instant lines and in `delayed_block` for delayed lines
+	Vector3 *lines;
 	size_t lines_count;
+	SlabAllocator<Vector3>::Block delayed_block;
 	Color color;
 
 	DelayedRendererLine();
 };
 
+/// Instances of the same type stored as a structure of arrays.
+/// Culling reads only bounds and states, and the visible GPU data is copied in contiguous runs.
+/// Ranges that start at a multiple of 64 can be culled and copied by different threads.
+struct InstancesStorage {
+	struct State {
+		static constexpr double EXPIRED = -1;
+
+		/// Deadline on the clock of the ProcessType for the delayed instances
+		double expiration_time;
+		bool is_used_one_time;
+
+		State() :
+				expiration_time(0),
+				is_used_one_time(true) {}
+
+		_FORCE_INLINE_ bool is_expired() const {
+			return expiration_time < 0;
+		}
+	};
+
+	// Bounding spheres split into components for CullingUtils
+	std::vector<real_t> bounds_x;
+	std::vector<real_t> bounds_y;
+	std::vector<real_t> bounds_z;
+	std::vector<real_t> bounds_radius;
+	std::vector<State> states;
+	std::vector<GeometryPoolData3DInstance> data;
+
+	/// Result of the last culling. One bit per instance.
+	std::vector<uint64_t> visible_mask;
+	/// Visible instances moved to the lower levels of detail. Used only by the types with InstancesLodChain.
+	std::vector<uint64_t> lod_masks[InstancesLodChain::MAX_LODS - 1];
+
+	_FORCE_INLINE_ size_t size() const {
+		return data.size();
+	}
+
+	_FORCE_INLINE_ void set_bounds(const size_t &p_idx, const SphereBounds &p_bounds) {
+		bounds_x[p_idx] = p_bounds.position.x;
+		bounds_y[p_idx] = p_bounds.position.y;
+		bounds_z[p_idx] = p_bounds.position.z;
+		bounds_radius[p_idx] = p_bounds.radius;
+	}
+
+	_FORCE_INLINE_ AABBMinMax get_bounds(const size_t &p_idx) const {
+		return SphereBounds(Vector3(bounds_x[p_idx], bounds_y[p_idx], bounds_z[p_idx]), bounds_radius[p_idx]);
+	}
+
+	_FORCE_INLINE_ bool is_visible(const size_t &p_idx) const {
+		return (visible_mask[p_idx >> 6] >> (p_idx & 63)) & 1;
+	}
+
+	_FORCE_INLINE_ bool is_visible_at_any_lod(const size_t &p_idx) const {
+		if (is_visible(p_idx)) {
+			return true;
+		}
+		for (const auto &mask : lod_masks) {
+			if (mask.size() > (p_idx >> 6) && ((mask[p_idx >> 6] >> (p_idx & 63)) & 1)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	_FORCE_INLINE_ const std::vector<uint64_t> &get_lod_mask(const int &p_lod) const {
+		return p_lod ? lod_masks[p_lod - 1] : visible_mask;
+	}
+
+	_FORCE_INLINE_ void set_visible(const size_t &p_idx, const bool &p_visible) {
+		if (p_visible) {
+			visible_mask[p_idx >> 6] |= 1ull << (p_idx & 63);
+		} else {
+			visible_mask[p_idx >> 6] &= ~(1ull << (p_idx & 63));
+		}
+	}
+
+	void push_back();
+	void resize(const size_t &p_size);
+	void clear();
+	/// Updates `visible_mask` for the instances in the range.
+	void cull(const size_t &p_begin, const size_t &p_end, const GeometryPoolCullingData &p_culling_data);
+	/// Hides the visible instances in the range that are behind the occluders and returns their number.
+	size_t cull_occluded(const size_t &p_begin, const size_t &p_end, const GeometryPoolCullingData &p_culling_data);
+	/// Hides the visible instances in the range that are too small on the screen and returns their number.
+	/// If `p_chain` is set, the remaining instances are moved from `visible_mask` to the masks of their levels of detail.
+	/// The masks of the lower levels must already have the size of `visible_mask`.
+	size_t apply_screen_size(const size_t &p_begin, const size_t &p_end, const GeometryPoolCullingData &p_culling_data, const InstancesLodChain *p_chain);
+	/// Returns the number of visible instances in the range at the level of detail.
+	size_t get_visible_count(const size_t &p_begin, const size_t &p_end, const int &p_lod = 0) const;
+	/// Moves the not expired instances to the beginning of the arrays while keeping their order.
+	size_t compact_not_expired();
+	/// Copies the data of the visible instances in the range. Consecutive instances are copied by a single `memcpy`.
+	/// If `r_is_changed` is set, `p_dst` must contain the data of the previous frame. Only the changed runs are overwritten
+	/// and `r_is_changed` is set to true if there were any.
+	size_t copy_visible_data(const size_t &p_begin, const size_t &p_end, float *p_dst, bool *r_is_changed = nullptr, const int &p_lod = 0) const;
+};
+
 class GeometryPool {
 private:
 	enum ShrinkTimers : char {
@@ -109,57 +290,89 @@ private:
 		TIME_USED_TO_SHRINK_DELAYED = 5,
 	};
 
-	bool is_no_depth_test = false;
+	// The delayed objects are culled using DynamicAABBTree only if there are many of them and they rarely change.
+	// Different thresholds are used to enable and disable the index so that it is not rebuilt every frame.
+	static constexpr size_t DELAYED_INDEX_MIN_SIZE = 8192;
+	static constexpr size_t DELAYED_INDEX_ENABLE_DIVIDER = 16;
+	static constexpr size_t DELAYED_INDEX_DISABLE_DIVIDER = 4;
 
-	template <class TInst>
-	struct ObjectsPool {
-		std::vector<TInst> instant = {};
-		std::vector<TInst> delayed = {};
+	_FORCE_INLINE_ static bool _is_delayed_index_needed(const bool &p_is_enabled, const size_t &p_size, const size_t &p_added) {
+		return p_size >= DELAYED_INDEX_MIN_SIZE && p_added < p_size / (p_is_enabled ? DELAYED_INDEX_DISABLE_DIVIDER : DELAYED_INDEX_ENABLE_DIVIDER);
+	}
+
+	bool is_no_depth_test = false;
 
+	/// Shrinking, expiration and the index of the delayed objects shared by ObjectsPool and InstancesPool.
+	/// The pools differ only in how they store the objects, so `TPool` provides the accessors:
+	/// the sizes of its storages, `_get_state`, `_get_index_leaf` and `_get_delayed_bounds` of a delayed object,
+	/// and the methods that resize, compact and clear the storages.
+	template <class TPool>
+	struct DelayedPool {
 		size_t used_instant = 0;
 		size_t used_delayed = 0;
 		size_t _prev_used_instant = 0;
-		size_t _prev_not_expired_delayed = 0;
 		double time_used_less_then_half_of_instant_pool = 0;
 		double time_used_less_then_quarter_of_delayed_pool = 0;
 
-		ObjectsPool() {
+		ExpirationQueue expiration;
+		DynamicAABBTree delayed_index;
+		bool is_delayed_index_enabled = false;
+		bool is_delayed_index_outdated = false;
+		size_t delayed_added = 0;
+
+		DelayedPool() {
 			time_used_less_then_half_of_instant_pool = TIME_USED_TO_SHRINK_INSTANT;
 			time_used_less_then_quarter_of_delayed_pool = TIME_USED_TO_SHRINK_DELAYED;
 		}
 
-		TInst *get(bool is_delayed) {
-			ZoneScoped;
-			auto objs = is_delayed ? &delayed : &instant;
-			auto used = is_delayed ? &_prev_not_expired_delayed : &used_instant;
+		_FORCE_INLINE_ TPool &self() {
+			return *static_cast<TPool *>(this);
+		}
 
-			if (is_delayed) {
-				while (objs->size() != (*used)) {
-					if (((*objs)[*used]).is_expired()) {
-						return &(*objs)[(*used)++];
-					}
-					(*used)++;
-				}
-			} else {
-				if (objs->size() != (*used)) {
-					return &(*objs)[(*used)++];
-				}
-			}
+		/// Must be called for each new delayed object
+		void set_expiration(const size_t &p_idx, const double &p_deadline) {
+			auto &state = self()._get_state(p_idx);
+			state.expiration_time = p_deadline;
+			state.is_used_one_time = false;
+			expiration.add((uint32_t)p_idx);
+		}
 
-			objs->push_back(TInst());
-			return &(*objs)[(*used)++];
+		/// Frees the objects that expired before `p_time`. The first frame of the physics objects is not counted, so their deadlines are moved by `p_delta`.
+		void update_expiration(const double &p_time, const double &p_delta, const bool &p_is_physics) {
+			ZoneScoped;
+			expiration.update(
+					p_time,
+					[this](const uint32_t &p_idx) {
+						auto &state = self()._get_state(p_idx);
+						state.expiration_time = std::decay_t<decltype(state)>::EXPIRED;
+						self()._hide_delayed(p_idx);
+						int32_t &leaf = self()._get_index_leaf(p_idx);
+						if (leaf != DynamicAABBTree::NULL_NODE) {
+							delayed_index.remove(leaf);
+							leaf = DynamicAABBTree::NULL_NODE;
+						}
+					},
+					[this, &p_delta, &p_is_physics](const uint32_t &p_idx) {
+						auto &state = self()._get_state(p_idx);
+						if (p_is_physics) {
+							state.expiration_time += p_delta;
+						}
+						state.is_used_one_time = true;
+						return state.expiration_time;
+					});
 		}
 
 		void reset_counter(double delta, int custom_type_of_buffer = 0) {
 			ZoneScoped;
-			if (instant.size() && used_instant <= (instant.size() * 0.5)) {
+			const size_t instant_size = self()._get_instant_size();
+			if (instant_size && used_instant <= (instant_size * 0.5)) {
 				time_used_less_then_half_of_instant_pool -= delta;
 				if (time_used_less_then_half_of_instant_pool <= 0) {
 					time_used_less_then_half_of_instant_pool = TIME_USED_TO_SHRINK_INSTANT;
 
-					DEV_PRINT_STD("Shrinking instant buffer for %s. From %d, to %d. Buffer type: %d\n", typeid(TInst).name(), instant.size(), used_instant, custom_type_of_buffer);
+					DEV_PRINT_STD("Shrinking instant buffer for %s. From %d, to %d. Buffer type: %d\n", TPool::_get_name(), instant_size, used_instant, custom_type_of_buffer);
 
-					instant.resize(used_instant);
+					self()._shrink_instant(used_instant);
 				}
 			} else {
 				time_used_less_then_half_of_instant_pool = TIME_USED_TO_SHRINK_INSTANT;
@@ -167,67 +380,358 @@ private:
 
 			_prev_used_instant = used_instant;
 			used_instant = 0;
-			_prev_not_expired_delayed = 0;
+			self()._reset_instant();
 
-			if (delayed.size() && used_delayed <= (delayed.size() * 0.5)) {
+			const size_t delayed_size = self()._get_delayed_size();
+			if (delayed_size && used_delayed <= (delayed_size * 0.5)) {
 				time_used_less_then_quarter_of_delayed_pool -= delta;
 				if (time_used_less_then_quarter_of_delayed_pool <= 0) {
 					time_used_less_then_quarter_of_delayed_pool = TIME_USED_TO_SHRINK_DELAYED;
 
-					DEV_PRINT_STD("Shrinking _delayed_ buffer for %s. From %d, to %d. Buffer type: %d\n", typeid(TInst).name(), delayed.size(), used_delayed, custom_type_of_buffer);
+					DEV_PRINT_STD("Shrinking _delayed_ buffer for %s. From %d, to %d. Buffer type: %d\n", TPool::_get_name(), delayed_size, used_delayed, custom_type_of_buffer);
 
-					std::sort(delayed.begin(), delayed.end(), [](const TInst &a, const TInst &b) { return (int)a.is_expired() < (int)b.is_expired(); });
-					delayed.resize(used_delayed);
+					expiration.rebuild(self()._compact_delayed(), [this](const size_t &p_idx, double &r_deadline, bool &r_is_rendered) {
+						const auto &state = self()._get_state(p_idx);
+						r_deadline = state.expiration_time;
+						r_is_rendered = state.is_used_one_time;
+						return true;
+					});
+					is_delayed_index_outdated = true;
 				}
 			} else {
 				time_used_less_then_quarter_of_delayed_pool = TIME_USED_TO_SHRINK_DELAYED;
 			}
+
+			update_delayed_index_state();
+		}
+
+		/// Must be called after changing the bounds of a delayed object
+		void update_delayed_index(const size_t &p_idx) {
+			delayed_added++;
+			if (!is_delayed_index_enabled)
+				return;
+
+			int32_t &leaf = self()._get_index_leaf(p_idx);
+			if (leaf != DynamicAABBTree::NULL_NODE) {
+				delayed_index.remove(leaf);
+			}
+			AABBMinMax bounds = self()._get_delayed_bounds(p_idx);
+			leaf = delayed_index.insert(bounds.min, bounds.max, (uint32_t)p_idx);
+		}
+
+		void update_delayed_index_state() {
+			ZoneScoped;
+			const size_t delayed_size = self()._get_delayed_size();
+			bool is_needed = _is_delayed_index_needed(is_delayed_index_enabled, delayed_size, delayed_added);
+			delayed_added = 0;
+
+			if (is_needed && (!is_delayed_index_enabled || is_delayed_index_outdated)) {
+				DEV_PRINT_STD("Building the index of delayed %s. Objects: %d\n", TPool::_get_name(), delayed_size);
+
+				delayed_index.clear();
+				for (size_t i = 0; i < delayed_size; i++) {
+					int32_t &leaf = self()._get_index_leaf(i);
+					if (self()._get_state(i).is_expired()) {
+						leaf = DynamicAABBTree::NULL_NODE;
+					} else {
+						AABBMinMax bounds = self()._get_delayed_bounds(i);
+						leaf = delayed_index.insert(bounds.min, bounds.max, (uint32_t)i);
+					}
+				}
+			} else if (!is_needed && is_delayed_index_enabled) {
+				DEV_PRINT_STD("Removing the index of delayed %s\n", TPool::_get_name());
+
+				delayed_index.clear();
+				for (size_t i = 0; i < delayed_size; i++) {
+					self()._get_index_leaf(i) = DynamicAABBTree::NULL_NODE;
+				}
+			}
+
+			is_delayed_index_enabled = is_needed;
+			is_delayed_index_outdated = false;
 		}
 
 		void clear_pools() {
-			instant.clear();
-			delayed.clear();
+			self()._clear_storages();
 			used_instant = 0;
 			used_delayed = 0;
 			_prev_used_instant = 0;
-			_prev_not_expired_delayed = 0;
 			time_used_less_then_half_of_instant_pool = 0;
+			expiration.clear();
+			delayed_index.clear();
+			is_delayed_index_enabled = false;
+			is_delayed_index_outdated = false;
+			delayed_added = 0;
+		}
+	};
+
+	template <class TInst>
+	struct ObjectsPool : public DelayedPool<ObjectsPool<TInst> > {
+		using Base = DelayedPool<ObjectsPool<TInst> >;
+		using Base::expiration;
+		using Base::used_instant;
+
+		// Points of the lines. Declared before the objects, because the blocks of the delayed objects must be freed first.
+		FrameArena<Vector3> instant_points;
+		SlabAllocator<Vector3> delayed_points;
+
+		std::vector<TInst> instant = {};
+		std::vector<TInst> delayed = {};
+
+		TInst *get(bool is_delayed) {
+			ZoneScoped;
+			if (is_delayed) {
+				uint32_t idx;
+				if (expiration.pop_free(idx)) {
+					return &delayed[idx];
+				}
+				delayed.push_back(TInst());
+				return &delayed.back();
+			}
+
+			if (instant.size() == used_instant) {
+				instant.push_back(TInst());
+			}
+			return &instant[used_instant++];
+		}
+
+		/// Must be called for each new delayed object
+		void set_expiration(TInst *p_inst, const double &p_deadline) {
+			Base::set_expiration((size_t)(p_inst - delayed.data()), p_deadline);
+		}
+
+		/// Must be called after changing the bounds of a delayed object
+		void update_delayed_index(TInst *p_inst) {
+			Base::update_delayed_index((size_t)(p_inst - delayed.data()));
+		}
+
+		// Accessors used by DelayedPool
+
+		static const char *_get_name() {
+			return typeid(TInst).name();
+		}
+		_FORCE_INLINE_ size_t _get_instant_size() const {
+			return instant.size();
+		}
+		_FORCE_INLINE_ size_t _get_delayed_size() const {
+			return delayed.size();
+		}
+		_FORCE_INLINE_ TInst &_get_state(const size_t &p_idx) {
+			return delayed[p_idx];
+		}
+		_FORCE_INLINE_ int32_t &_get_index_leaf(const size_t &p_idx) {
+			return delayed[p_idx].index_leaf;
+		}
+		_FORCE_INLINE_ AABBMinMax _get_delayed_bounds(const size_t &p_idx) const {
+			return delayed[p_idx].bounds;
+		}
+		_FORCE_INLINE_ void _hide_delayed(const size_t &p_idx) {
+			delayed[p_idx].is_visible = false;
+		}
+
+		void _shrink_instant(const size_t &p_size) {
+			instant.resize(p_size);
+			instant_points.shrink();
+		}
+
+		void _reset_instant() {
+			// The instant objects are no longer used, so all their points are freed at once
+			instant_points.reset();
+		}
+
+		/// Moves the not expired objects to the beginning while keeping their order and returns their number
+		size_t _compact_delayed() {
+			size_t not_expired = 0;
+			for (size_t i = 0; i < delayed.size(); i++) {
+				if (!delayed[i].is_expired()) {
+					if (not_expired != i) {
+						delayed[not_expired] = std::move(delayed[i]);
+					}
+					not_expired++;
+				}
+			}
+			delayed.resize(not_expired);
+			delayed_points.release_if_unused();
+			return not_expired;
+		}
+
+		void _clear_storages() {
+			instant.clear();
+			delayed.clear();
+			instant_points.clear();
+			delayed_points.release_if_unused();
+		}
+	};
+
+	struct InstancesPool : public DelayedPool<InstancesPool> {
+		InstancesStorage instant;
+		InstancesStorage delayed;
+
+		/// Leaves of `delayed_index` for each delayed instance
+		std::vector<int32_t> delayed_index_leaves;
+
+		/// Returns the index of a free slot in the `instant` or `delayed` storage
+		size_t get(bool is_delayed) {
+			ZoneScoped;
+			if (is_delayed) {
+				uint32_t idx;
+				if (expiration.pop_free(idx)) {
+					return idx;
+				}
+
+				delayed.push_back();
+				delayed_index_leaves.push_back(DynamicAABBTree::NULL_NODE);
+				return delayed.size() - 1;
+			} else {
+				if (instant.size() == used_instant) {
+					instant.push_back();
+				}
+				return used_instant++;
+			}
+		}
+
+		/// Returns the index of the first of `p_count` consecutive free slots in the `instant` storage
+		size_t get_instant_range(const size_t &p_count) {
+			ZoneScoped;
+			size_t begin = used_instant;
+			used_instant += p_count;
+			if (instant.size() < used_instant) {
+				instant.resize(used_instant);
+			}
+			return begin;
+		}
+
+		// Accessors used by DelayedPool
+
+		static const char *_get_name() {
+			return "instances";
+		}
+		_FORCE_INLINE_ size_t _get_instant_size() const {
+			return instant.size();
+		}
+		_FORCE_INLINE_ size_t _get_delayed_size() const {
+			return delayed.size();
+		}
+		_FORCE_INLINE_ InstancesStorage::State &_get_state(const size_t &p_idx) {
+			return delayed.states[p_idx];
+		}
+		_FORCE_INLINE_ int32_t &_get_index_leaf(const size_t &p_idx) {
+			return delayed_index_leaves[p_idx];
+		}
+		_FORCE_INLINE_ AABBMinMax _get_delayed_bounds(const size_t &p_idx) const {
+			return delayed.get_bounds(p_idx);
+		}
+		_FORCE_INLINE_ void _hide_delayed(const size_t &p_idx) {
+			delayed.set_visible(p_idx, false);
+		}
+
+		void _shrink_instant(const size_t &p_size) {
+			instant.resize(p_size);
+		}
+
+		void _reset_instant() {}
+
+		/// Moves the not expired instances to the beginning while keeping their order and returns their number
+		size_t _compact_delayed() {
+			delayed.resize(delayed.compact_not_expired());
+			delayed_index_leaves.resize(delayed.size());
+			return delayed.size();
+		}
+
+		void _clear_storages() {
+			instant.clear();
+			delayed.clear();
+			delayed_index_leaves.clear();
 		}
 	};
 
 	struct processTypePools {
-		ObjectsPool<DelayedRendererInstance> instances[(int)InstanceType::MAX];
+		InstancesPool instances[(int)InstanceType::MAX];
 		ObjectsPool<DelayedRendererLine> lines;
 	};
 
-	std::unordered_map<Viewport *, processTypePools[(int)ProcessType::MAX]> pools;
-	std::unordered_map<Viewport *, uint64_t> viewport_ids;
+	/// Everything that belongs to a viewport is kept in one place, so the culling jobs only need a pointer to it.
+	struct ViewportPools {
+		Viewport *viewport;
+		uint64_t viewport_id;
+		/// Culling data of the current frame. Set by fill_mesh_data
+		const GeometryPoolCullingData *culling_data = nullptr;
+		processTypePools procs[(int)ProcessType::MAX];
+	};
+	// The pools can't be moved, because the lines keep pointers to their allocators
+	std::vector<std::unique_ptr<ViewportPools> > pools;
+
+	/// Pools of the viewport slots indexed by the slot index, so the commands skip the viewport lookups.
+	/// An entry is valid only if its generation matches the generation of the slot.
+	struct SlotPools {
+		uint32_t generation = 0;
+		processTypePools *pools = nullptr;
+	};
+	std::vector<SlotPools> slot_pools;
+
+	/// Monotonic clock of each ProcessType. It keeps running while the rendering is frozen, so the objects expire anyway.
+	double process_times[(int)ProcessType::MAX] = {};
+	/// Clock of each ProcessType at the last update of the expiration. The deadlines of new delayed objects are based on it.
+	double expiration_times[(int)ProcessType::MAX] = {};
+
+	_FORCE_INLINE_ double _get_deadline(const ProcessType &p_proc, const real_t &p_exp_time) const {
+		return expiration_times[(int)p_proc] + p_exp_time;
+	}
 
-	double process_delta_sum = 0;
-	double physics_delta_sum = 0;
+	// The lines are drawn by a single surface that is kept between frames and updated in place.
+	// It grows geometrically and shrinks only when less than a quarter of it is used.
+	static constexpr size_t LINES_SURFACE_MIN_CAPACITY = 1024;
+
+	struct LinesSurface {
+		size_t capacity = 0;
+		// Vertexes written in the last frame
+		size_t used = 0;
+		uint32_t vertex_stride = 0;
+		uint32_t attribute_stride = 0;
+		uint32_t color_offset = 0;
+		AABB aabb;
+		PackedByteArray vertexes;
+		PackedByteArray attributes;
+	} lines_surface;
 
 	PackedFloat32Array temp_instances_buffers[(int)InstanceType::MAX];
+#ifdef COMPACT_INSTANCES_ENABLED
+	// Used only if the compact format is not supported by the renderer
+	PackedFloat32Array temp_unpacked_instances_buffer;
+#endif
 	size_t prev_buffer_visible_instance_count[(int)InstanceType::MAX] = {};
 	size_t prev_buffer_visible_lines_count = 0;
 
 	uint64_t stat_visible_instances = 0;
 	uint64_t stat_visible_lines = 0;
+	uint64_t stat_culling_index_nodes = 0;
+	uint64_t stat_culling_index_hits = 0;
+	uint64_t stat_culling_linear_checks = 0;
+	uint64_t stat_culling_rejected_by_size = 0;
+	uint64_t stat_culling_occluded = 0;
+	uint64_t stat_uploaded_instances_bytes = 0;
 	int64_t time_spent_to_fill_buffers_of_instances = 0;
 	int64_t time_spent_to_fill_buffers_of_lines = 0;
 	int64_t time_spent_to_cull_instances = 0;
 	int64_t time_spent_to_cull_lines = 0;
+	std::vector<int64_t> time_spent_by_workers;
 
-	// Internal use of raw pointer to avoid ref/unref
-	Color _scoped_config_to_custom(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg);
-	InstanceType _scoped_config_type_convert(ConvertableInstanceType p_type, const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg);
-	GeometryType _scoped_config_get_geometry_type(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg);
-
-	bool _is_viewport_empty(Viewport *vp);
+	bool _is_viewport_empty(const ViewportPools &p_vp_pool) const;
+	/// Returns the pools of the viewport. The lookup is skipped if the slot was already used.
+	processTypePools *_get_viewport_pools(const uint64_t &p_slot, Viewport *p_vp, const uint64_t &p_vp_id);
 
-	void fill_instance_data(const std::vector<Ref<MultiMesh> *> &p_meshes, std::unordered_map<Viewport *, std::shared_ptr<GeometryPoolCullingData> > &p_culling_data);
-	void fill_lines_data(Ref<ArrayMesh> p_ig, std::unordered_map<Viewport *, std::shared_ptr<GeometryPoolCullingData> > &p_culling_data);
+	/// Frees the expired delayed objects. Only the expired and the new objects are checked.
+	void update_expiration();
+	void fill_instance_data(const std::vector<Ref<MultiMesh> *> &p_meshes, JobPool &p_job_pool);
+	void fill_lines_data(Ref<ArrayMesh> p_ig, JobPool &p_job_pool);
+	void _update_lines_surface(Ref<ArrayMesh> p_ig, const std::vector<DelayedRendererLine *> &p_lines, const size_t &p_used_vertexes);
 
 public:
+	// Internal use of raw pointer to avoid ref/unref
+	static Color _scoped_config_to_custom(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg);
+	static InstanceType _scoped_config_type_convert(ConvertableInstanceType p_type, const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg);
+	static GeometryType _scoped_config_get_geometry_type(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg);
+
 	GeometryPool() {}
 
 	~GeometryPool() {
@@ -237,17 +741,23 @@ public:
 
 	std::vector<Viewport *> get_and_validate_viewports();
 
-	void fill_mesh_data(const std::vector<Ref<MultiMesh> *> &p_meshes, Ref<ArrayMesh> p_ig, std::unordered_map<Viewport *, std::shared_ptr<GeometryPoolCullingData> > &p_culling_data);
+	void fill_mesh_data(const std::vector<Ref<MultiMesh> *> &p_meshes, Ref<ArrayMesh> p_ig, std::unordered_map<Viewport *, std::shared_ptr<GeometryPoolCullingData> > &p_culling_data, JobPool &p_job_pool);
 	void reset_counter(const double &p_delta, const ProcessType &p_proc = ProcessType::MAX);
 	void reset_visible_objects();
 	void set_stats(Ref<DebugDraw3DStats> &p_stats) const;
 	void clear_pool();
-	void for_each_instance(const std::function<void(DelayedRendererInstance *)> &p_func);
+	void for_each_instance(const std::function<void(GeometryPoolData3DInstance *, const AABBMinMax &, const bool &)> &p_func);
 	void for_each_line(const std::function<void(DelayedRendererLine *)> &p_func);
 	void update_expiration_delta(const double &p_delta, const ProcessType &p_proc);
 	void add_or_update_instance(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg, ConvertableInstanceType p_type, const real_t &p_exp_time, const ProcessType &p_proc, const Transform3D &p_transform, const Color &p_col, const SphereBounds &p_bounds, const Color *p_custom_col = nullptr);
 	void add_or_update_instance(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg, InstanceType p_type, const real_t &p_exp_time, const ProcessType &p_proc, const Transform3D &p_transform, const Color &p_col, const SphereBounds &p_bounds, const Color *p_custom_col = nullptr);
-	void add_or_update_line(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg, const real_t &p_exp_time, const ProcessType &p_proc, std::unique_ptr<Vector3[]> p_lines, const size_t p_line_count, const Color &p_col, const AABB &p_aabb);
+	void add_or_update_instance(const uint64_t &p_vp_slot, Viewport *p_vp, const uint64_t &p_vp_id, InstanceType p_type, const real_t &p_exp_time, const ProcessType &p_proc, const Transform3D &p_transform, const Color &p_col, const Color &p_custom_col, const SphereBounds &p_bounds);
+	/// Adds instances that differ only in position. `p_origin_offset` is subtracted from the positions of the transforms, but not from the bounds.
+	void add_points(const uint64_t &p_vp_slot, Viewport *p_vp, const uint64_t &p_vp_id, InstanceType p_type, const real_t &p_exp_time, const ProcessType &p_proc, const Vector3 *p_points, const size_t &p_count, const real_t &p_scale, const real_t &p_bounds_radius, const Color &p_col, const Color &p_custom_col, const Vector3 &p_origin_offset = Vector3());
+
+	/// Returns the memory for `p_line_count` points of the line which must be filled by the caller.
+	Vector3 *add_or_update_line(const std::shared_ptr<DebugDraw3DScopeConfig::Data> &p_cfg, const real_t &p_exp_time, const ProcessType &p_proc, const size_t p_line_count, const Color &p_col, const AABB &p_aabb);
+	Vector3 *add_or_update_line(const uint64_t &p_vp_slot, Viewport *p_vp, const uint64_t &p_vp_id, const real_t &p_exp_time, const ProcessType &p_proc, const size_t p_line_count, const Color &p_col, const AABB &p_aabb);
 };
 
 #endif
\ No newline at end of file
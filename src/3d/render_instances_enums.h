@@ -18,6 +18,7 @@ enum class ConvertableInstanceType : char {
 
 enum class InstanceType : char {
 	// Basic wireframe
+	LINE,
 	CUBE,
 	CUBE_CENTERED,
 	ARROWHEAD,
@@ -27,6 +28,12 @@ enum class InstanceType : char {
 	CYLINDER,
 	CYLINDER_AB,
 
+	// Lower levels of detail of the basic wireframe. Selected automatically.
+	SPHERE_LOD1,
+	SPHERE_LOD2,
+	CYLINDER_LOD1,
+	CYLINDER_AB_LOD1,
+
 	// Volumetric from wireframes
 	LINE_VOLUMETRIC,
 	CUBE_VOLUMETRIC,
@@ -27,11 +27,21 @@ void DebugDraw3DStats::_bind_methods() {
 	REG_PROPERTY_NO_SET(time_culling_lines_usec, Variant::INT);
 	REG_PROPERTY_NO_SET(total_time_culling_usec, Variant::INT);
 
+	REG_PROPERTY_NO_SET(culling_index_nodes, Variant::INT);
+	REG_PROPERTY_NO_SET(culling_index_hits, Variant::INT);
+	REG_PROPERTY_NO_SET(culling_linear_checks, Variant::INT);
+	REG_PROPERTY_NO_SET(culling_rejected_by_size, Variant::INT);
+	REG_PROPERTY_NO_SET(culling_occluded, Variant::INT);
+
+	REG_PROPERTY_NO_SET(uploaded_instances_bytes, Variant::INT);
+
 	REG_PROPERTY_NO_SET(total_time_spent_usec, Variant::INT);
 
 	REG_PROPERTY_NO_SET(created_scoped_configs, Variant::INT);
 	REG_PROPERTY_NO_SET(orphan_scoped_configs, Variant::INT);
 
+	REG_PROPERTY_NO_SET(time_workers_usec, Variant::PACKED_INT64_ARRAY);
+
 #undef REG_PROPERTY_NO_SET
 #pragma endregion
 }
@@ -41,6 +51,22 @@ void DebugDraw3DStats::set_scoped_config_stats(const int64_t &p_created_scoped_c
 	orphan_scoped_configs = p_orphan_scoped_configs;
 }
 
+void DebugDraw3DStats::set_culling_index_stats(const int64_t &p_culling_index_nodes, const int64_t &p_culling_index_hits, const int64_t &p_culling_linear_checks, const int64_t &p_culling_rejected_by_size, const int64_t &p_culling_occluded) {
+	culling_index_nodes = p_culling_index_nodes;
+	culling_index_hits = p_culling_index_hits;
+	culling_linear_checks = p_culling_linear_checks;
+	culling_rejected_by_size = p_culling_rejected_by_size;
+	culling_occluded = p_culling_occluded;
+}
+
+void DebugDraw3DStats::set_upload_stats(const int64_t &p_uploaded_instances_bytes) {
+	uploaded_instances_bytes = p_uploaded_instances_bytes;
+}
+
+void DebugDraw3DStats::set_workers_stats(const PackedInt64Array &p_time_workers_usec) {
+	time_workers_usec = p_time_workers_usec;
+}
+
 void DebugDraw3DStats::set_render_stats(
 		const int64_t &p_instances,
 		const int64_t &p_lines,
@@ -101,5 +127,20 @@ void DebugDraw3DStats::combine_with(const Ref<DebugDraw3DStats> p_other) {
 	time_culling_lines_usec += p_other->time_culling_lines_usec;
 	total_time_culling_usec += p_other->total_time_culling_usec;
 
+	culling_index_nodes += p_other->culling_index_nodes;
+	culling_index_hits += p_other->culling_index_hits;
+	culling_linear_checks += p_other->culling_linear_checks;
+	culling_rejected_by_size += p_other->culling_rejected_by_size;
+	culling_occluded += p_other->culling_occluded;
+
+	uploaded_instances_bytes += p_other->uploaded_instances_bytes;
+
 	total_time_spent_usec += p_other->total_time_spent_usec;
+
+	for (int64_t i = time_workers_usec.size(); i < p_other->time_workers_usec.size(); i++) {
+		time_workers_usec.push_back(0);
+	}
+	for (int64_t i = 0; i < p_other->time_workers_usec.size(); i++) {
+		time_workers_usec[i] += p_other->time_workers_usec[i];
+	}
 }
\ No newline at end of file
@@ -20,6 +20,15 @@ using namespace godot;
  * `instances_physics` reports how many instances were created inside `_physics_process`.
  *
  * `total_time_spent_usec` reports the time in microseconds spent to process everything and display the geometry on the screen.
+ *
+ * `culling_index_nodes` and `culling_index_hits` report how many nodes of the spatial index of long-lived geometry were checked and how many objects were found visible using it.
+ * `culling_linear_checks` reports how many objects were checked one by one.
+ * `culling_rejected_by_size` reports how many visible instances were not drawn because they were smaller than DebugDraw3DConfig.set_min_screen_size.
+ * `culling_occluded` reports how many visible instances were not drawn because they were hidden by the occluders, see DebugDraw3DConfig.set_use_occlusion_culling.
+ *
+ * `uploaded_instances_bytes` reports how many bytes of instance data were sent to the MultiMeshes. It stays at zero while the visible instances do not change.
+ *
+ * `time_workers_usec` reports the time in microseconds spent by each worker thread to cull and fill the buffers of instances. The first worker is the main thread.
  */
 class DebugDraw3DStats : public RefCounted {
 	GDCLASS(DebugDraw3DStats, RefCounted)
@@ -56,6 +65,14 @@ public:                                      \
 	DEFINE_DEFAULT_PROP(time_culling_lines_usec, int64_t, 0);
 	DEFINE_DEFAULT_PROP(total_time_culling_usec, int64_t, 0);
 
+	DEFINE_DEFAULT_PROP(culling_index_nodes, int64_t, 0);
+	DEFINE_DEFAULT_PROP(culling_index_hits, int64_t, 0);
+	DEFINE_DEFAULT_PROP(culling_linear_checks, int64_t, 0);
+	DEFINE_DEFAULT_PROP(culling_rejected_by_size, int64_t, 0);
+	DEFINE_DEFAULT_PROP(culling_occluded, int64_t, 0);
+
+	DEFINE_DEFAULT_PROP(uploaded_instances_bytes, int64_t, 0);
+
 	DEFINE_DEFAULT_PROP(total_time_spent_usec, int64_t, 0);
 
 	DEFINE_DEFAULT_PROP(created_scoped_configs, int64_t, 0);
@@ -63,6 +80,13 @@ public:                                      \
 
 #undef DEFINE_DEFAULT_PROP
 
+private:
+	PackedInt64Array time_workers_usec;
+
+public:
+	PackedInt64Array get_time_workers_usec() const { return time_workers_usec; }
+	void set_time_workers_usec(PackedInt64Array val) {}
+
 	DebugDraw3DStats(){};
 
 	/// @private
@@ -70,6 +94,20 @@ public:                                      \
 			const int64_t &p_created_scoped_configs,
 			const int64_t &p_orphan_scoped_configs);
 
+	/// @private
+	void set_culling_index_stats(
+			const int64_t &p_culling_index_nodes,
+			const int64_t &p_culling_index_hits,
+			const int64_t &p_culling_linear_checks,
+			const int64_t &p_culling_rejected_by_size,
+			const int64_t &p_culling_occluded);
+
+	/// @private
+	void set_upload_stats(const int64_t &p_uploaded_instances_bytes);
+
+	/// @private
+	void set_workers_stats(const PackedInt64Array &p_time_workers_usec);
+
 	/// @private
 	void set_render_stats(
 			const int64_t &p_instances,
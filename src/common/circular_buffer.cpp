@@ -0,0 +1,78 @@
+#include "circular_buffer.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CIRCULAR_BUFFER_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define CIRCULAR_BUFFER_NEON
+#include <arm_neon.h>
+#endif
+
+void CircularBufferUtils::scan_min_max_sum(const double *p_data, const size_t &p_count, double *r_min, double *r_max, double *r_sum) {
+	double min = p_data[0];
+	double max = p_data[0];
+	double sum = 0;
+	size_t i = 0;
+
+	// Two registers for each result, so the next iteration doesn't wait for the previous one
+#ifdef CIRCULAR_BUFFER_SSE2
+	if (p_count >= 4) {
+		__m128d min0 = _mm_loadu_pd(p_data), min1 = _mm_loadu_pd(p_data + 2);
+		__m128d max0 = min0, max1 = min1;
+		__m128d sum0 = _mm_setzero_pd(), sum1 = _mm_setzero_pd();
+
+		for (; i + 4 <= p_count; i += 4) {
+			const __m128d a = _mm_loadu_pd(p_data + i);
+			const __m128d b = _mm_loadu_pd(p_data + i + 2);
+			min0 = _mm_min_pd(min0, a);
+			min1 = _mm_min_pd(min1, b);
+			max0 = _mm_max_pd(max0, a);
+			max1 = _mm_max_pd(max1, b);
+			sum0 = _mm_add_pd(sum0, a);
+			sum1 = _mm_add_pd(sum1, b);
+		}
+
+		double res[2];
+		_mm_storeu_pd(res, _mm_min_pd(min0, min1));
+		min = std::min(res[0], res[1]);
+		_mm_storeu_pd(res, _mm_max_pd(max0, max1));
+		max = std::max(res[0], res[1]);
+		_mm_storeu_pd(res, _mm_add_pd(sum0, sum1));
+		sum = res[0] + res[1];
+	}
+#elif defined(CIRCULAR_BUFFER_NEON)
+	if (p_count >= 4) {
+		float64x2_t min0 = vld1q_f64(p_data), min1 = vld1q_f64(p_data + 2);
+		float64x2_t max0 = min0, max1 = min1;
+		float64x2_t sum0 = vdupq_n_f64(0), sum1 = vdupq_n_f64(0);
+
+		for (; i + 4 <= p_count; i += 4) {
+			const float64x2_t a = vld1q_f64(p_data + i);
+			const float64x2_t b = vld1q_f64(p_data + i + 2);
+			min0 = vminq_f64(min0, a);
+			min1 = vminq_f64(min1, b);
+			max0 = vmaxq_f64(max0, a);
+			max1 = vmaxq_f64(max1, b);
+			sum0 = vaddq_f64(sum0, a);
+			sum1 = vaddq_f64(sum1, b);
+		}
+
+		min = vminvq_f64(vminq_f64(min0, min1));
+		max = vmaxvq_f64(vmaxq_f64(max0, max1));
+		sum = vaddvq_f64(vaddq_f64(sum0, sum1));
+	}
+#endif
+
+	for (; i < p_count; i++) {
+		const double v = p_data[i];
+		min = v < min ? v : min;
+		max = v > max ? v : max;
+		sum += v;
+	}
+
+	*r_min = min;
+	*r_max = max;
+	*r_sum = sum;
+}
@@ -1,40 +1,129 @@
 #pragma once
 
+#include <cstddef>
 #include <memory>
 #include <mutex>
 
+class CircularBufferUtils {
+public:
+	/// Returns the minimum, maximum and sum of the values. `p_count` must not be zero.
+	/// Uses SSE2 or NEON to process 4 values per iteration.
+	static void scan_min_max_sum(const double *p_data, const size_t &p_count, double *r_min, double *r_max, double *r_sum);
+
+	template <typename TValue>
+	static void scan_min_max_sum(const TValue *p_data, const size_t &p_count, TValue *r_min, TValue *r_max, TValue *r_sum) {
+		TValue min = p_data[0];
+		TValue max = p_data[0];
+		TValue sum = 0;
+		for (size_t i = 0; i < p_count; i++) {
+			const TValue v = p_data[i];
+			min = v < min ? v : min;
+			max = v > max ? v : max;
+			sum += v;
+		}
+		*r_min = min;
+		*r_max = max;
+		*r_sum = sum;
+	}
+};
+
+/// Buffer of the last `buffer_size` values.
+/// The minimum, maximum and sum of the values are updated on each `add`, so `get_min_max_avg` does not iterate over the buffer.
 template <typename TValue>
 class CircularBuffer {
+	/// Ring of positions in `buffer`. It never stores more positions than the buffer has values.
+	class PositionDeque {
+		std::unique_ptr<size_t[]> data;
+		size_t capacity = 0;
+		size_t head = 0;
+		size_t count = 0;
+
+		size_t _wrap(const size_t &p_idx) const {
+			return p_idx >= capacity ? p_idx - capacity : p_idx;
+		}
+
+	public:
+		void resize(const size_t &p_capacity) {
+			data.reset(new size_t[p_capacity]);
+			capacity = p_capacity;
+			clear();
+		}
+
+		void clear() {
+			head = 0;
+			count = 0;
+		}
+
+		bool empty() const {
+			return !count;
+		}
+
+		size_t front() const {
+			return data[head];
+		}
+
+		size_t back() const {
+			return data[_wrap(head + count - 1)];
+		}
+
+		void push_back(const size_t &p_pos) {
+			data[_wrap(head + count)] = p_pos;
+			count++;
+		}
+
+		void pop_back() {
+			count--;
+		}
+
+		void pop_front() {
+			head = _wrap(head + 1);
+			count--;
+		}
+	};
+
 	std::unique_ptr<TValue[]> buffer;
 	size_t buf_size;
 	size_t start;
 	size_t end;
 	bool _is_filled;
 
+	// Monotonic queues: the values at these positions decrease (max) or increase (min) from the front,
+	// so the front is always the maximum or minimum of the buffer.
+	PositionDeque max_positions;
+	PositionDeque min_positions;
+	// Running sum. It is recalculated once per `buf_size` additions to remove the accumulated rounding errors.
+	TValue sum;
+	size_t adds_since_sum_update;
+
+	void _allocate(const size_t &p_size) {
+		buf_size = p_size;
+		buffer.reset(new TValue[buf_size]);
+		max_positions.resize(buf_size);
+		min_positions.resize(buf_size);
+		reset();
+	}
+
 public:
 	CircularBuffer() :
 			buffer(nullptr),
 			buf_size(0),
 			start(0),
 			end(0),
-			_is_filled(false) {
+			_is_filled(false),
+			sum(0),
+			adds_since_sum_update(0) {
 	}
 
 	CircularBuffer(size_t p_buffer_size) :
-			buffer(new TValue[p_buffer_size]),
-			buf_size(p_buffer_size),
-			start(0),
-			end(0),
-			_is_filled(false) {
+			CircularBuffer() {
+		_allocate(p_buffer_size);
 	}
 
 	CircularBuffer<TValue> &operator=(const CircularBuffer<TValue> &other) {
 		if (this == &other)
 			return *this;
 
-		reset();
-		buf_size = other.buf_size;
-		buffer.reset(new TValue[buf_size]);
+		_allocate(other.buf_size);
 
 		return *this;
 	}
@@ -43,12 +132,14 @@ public:
 		start = 0;
 		end = 0;
 		_is_filled = 0;
+		max_positions.clear();
+		min_positions.clear();
+		sum = 0;
+		adds_since_sum_update = 0;
 	}
 
 	void resize(size_t p_size) {
-		reset();
-		buf_size = p_size;
-		buffer.reset(new TValue[buf_size]);
+		_allocate(p_size);
 	}
 
 	size_t size() const {
@@ -64,7 +155,32 @@ public:
 	}
 
 	void add(TValue p_v) {
-		buffer[end++] = p_v;
+		if (_is_filled) {
+			// The oldest value is overwritten, so it is removed from the statistics
+			if (!max_positions.empty() && max_positions.front() == end) {
+				max_positions.pop_front();
+			}
+			if (!min_positions.empty() && min_positions.front() == end) {
+				min_positions.pop_front();
+			}
+			sum -= buffer[end];
+		}
+
+		buffer[end] = p_v;
+		sum += p_v;
+
+		// Older values that can no longer be the maximum or minimum
+		while (!max_positions.empty() && buffer[max_positions.back()] <= p_v) {
+			max_positions.pop_back();
+		}
+		max_positions.push_back(end);
+
+		while (!min_positions.empty() && buffer[min_positions.back()] >= p_v) {
+			min_positions.pop_back();
+		}
+		min_positions.push_back(end);
+
+		end++;
 
 		if (end == buf_size) {
 			_is_filled = true;
@@ -75,6 +191,12 @@ public:
 				start = 0;
 			}
 		}
+
+		if (++adds_since_sum_update >= buf_size) {
+			TValue min, max;
+			CircularBufferUtils::scan_min_max_sum(buffer.get(), size(), &min, &max, &sum);
+			adds_since_sum_update = 0;
+		}
 	}
 
 	TValue get(const size_t &p_idx) const {
@@ -82,21 +204,10 @@ public:
 		return buffer[pos >= buf_size ? pos - buf_size : pos];
 	}
 
-	void get_min_max_avg(TValue *p_min, TValue *p_max, TValue *p_avg) {
+	void get_min_max_avg(TValue *p_min, TValue *p_max, TValue *p_avg) const {
 		if (size()) {
-			TValue sum = get(0);
-			*p_min = get(0);
-			*p_max = get(0);
-
-			for (size_t i = 1; i < size(); i++) {
-				TValue v = get(i);
-				if (v < *p_min) {
-					*p_min = v;
-				} else if (v > *p_max) {
-					*p_max = v;
-				}
-				sum += v;
-			}
+			*p_min = buffer[min_positions.front()];
+			*p_max = buffer[max_positions.front()];
 			*p_avg = sum / size();
 			return;
 		}
@@ -104,4 +215,18 @@ public:
 		*p_min = *p_max = *p_avg = 0;
 		return;
 	}
+
+	/// Same as `get_min_max_avg`, but iterates over all values instead of using the values updated in `add`.
+	void scan_min_max_avg(TValue *p_min, TValue *p_max, TValue *p_avg) const {
+		if (size()) {
+			// The values always take the first `size()` elements of the buffer
+			TValue scan_sum;
+			CircularBufferUtils::scan_min_max_sum(buffer.get(), size(), p_min, p_max, &scan_sum);
+			*p_avg = scan_sum / size();
+			return;
+		}
+
+		*p_min = *p_max = *p_avg = 0;
+		return;
+	}
 };
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+/// Bump allocator for arrays that are only needed until the end of a frame.
+/// Memory is taken from large blocks that are kept between frames, so `reset` is O(1) and a stable frame does not allocate.
+template <typename TValue, size_t BLOCK_SIZE = 16384>
+class FrameArena {
+	struct Block {
+		std::unique_ptr<TValue[]> data;
+		size_t size;
+	};
+
+	std::vector<Block> blocks;
+	size_t current_block;
+	size_t current_used;
+
+public:
+	FrameArena() :
+			current_block(0),
+			current_used(0) {
+	}
+
+	FrameArena(const FrameArena &) = delete;
+	FrameArena &operator=(const FrameArena &) = delete;
+
+	TValue *allocate(const size_t &p_count) {
+		while (current_block < blocks.size()) {
+			Block &b = blocks[current_block];
+			if (b.size - current_used >= p_count) {
+				TValue *res = b.data.get() + current_used;
+				current_used += p_count;
+				return res;
+			}
+
+			// Arrays that are larger than the remaining blocks get their own block
+			if (current_block + 1 == blocks.size() || blocks[current_block + 1].size < p_count) {
+				break;
+			}
+
+			current_block++;
+			current_used = 0;
+		}
+
+		size_t new_size = std::max(p_count, (size_t)BLOCK_SIZE);
+		size_t pos = blocks.size() ? current_block + 1 : 0;
+		blocks.insert(blocks.begin() + pos, Block{ std::unique_ptr<TValue[]>(new TValue[new_size]), new_size });
+
+		current_block = pos;
+		current_used = p_count;
+		return blocks[pos].data.get();
+	}
+
+	/// Makes all the previously allocated memory available again.
+	void reset() {
+		current_block = 0;
+		current_used = 0;
+	}
+
+	/// Frees the blocks that were not used since the last `reset`.
+	void shrink() {
+		size_t used_blocks = current_used ? current_block + 1 : current_block;
+		if (blocks.size() > used_blocks) {
+			blocks.resize(used_blocks);
+		}
+	}
+
+	void clear() {
+		blocks.clear();
+		reset();
+	}
+
+	size_t get_allocated_size() const {
+		size_t res = 0;
+		for (const auto &b : blocks) {
+			res += b.size;
+		}
+		return res;
+	}
+};
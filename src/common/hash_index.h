@@ -0,0 +1,112 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+/// Open addressing hash table that maps precomputed hashes to indexes of elements stored in another array.
+/// The keys are not stored, so the caller compares them using the index. Uses linear probing and
+/// removes entries by shifting the following ones back, so there are no tombstones.
+class HashIndex {
+public:
+	static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+
+private:
+	static constexpr size_t MIN_CAPACITY = 16;
+
+	struct Entry {
+		uint32_t hash;
+		// INVALID_INDEX for empty entries
+		uint32_t index;
+	};
+
+	std::vector<Entry> entries;
+	size_t mask = 0;
+	size_t used = 0;
+
+	void _grow() {
+		std::vector<Entry> old = std::move(entries);
+		size_t capacity = old.size() ? old.size() * 2 : MIN_CAPACITY;
+		entries.assign(capacity, Entry{ 0, INVALID_INDEX });
+		mask = capacity - 1;
+		used = 0;
+
+		for (const Entry &e : old) {
+			if (e.index != INVALID_INDEX) {
+				insert(e.hash, e.index);
+			}
+		}
+	}
+
+public:
+	/// Returns the index of the element for which `p_is_equal(index)` returns true or INVALID_INDEX.
+	template <class TEqual>
+	uint32_t find(const uint32_t &p_hash, TEqual p_is_equal) const {
+		if (!used) {
+			return INVALID_INDEX;
+		}
+
+		for (size_t i = p_hash & mask;; i = (i + 1) & mask) {
+			const Entry &e = entries[i];
+			if (e.index == INVALID_INDEX) {
+				return INVALID_INDEX;
+			}
+			if (e.hash == p_hash && p_is_equal(e.index)) {
+				return e.index;
+			}
+		}
+	}
+
+	/// Adds the index of a new element. The key must not already be in the table.
+	void insert(const uint32_t &p_hash, const uint32_t &p_index) {
+		// The load factor is kept below 1/2 to make the probe sequences short
+		if ((used + 1) * 2 > entries.size()) {
+			_grow();
+		}
+
+		size_t i = p_hash & mask;
+		while (entries[i].index != INVALID_INDEX) {
+			i = (i + 1) & mask;
+		}
+		entries[i] = Entry{ p_hash, p_index };
+		used++;
+	}
+
+	/// Removes the entry with the index of the element.
+	void erase(const uint32_t &p_hash, const uint32_t &p_index) {
+		if (!used) {
+			return;
+		}
+
+		size_t i = p_hash & mask;
+		while (entries[i].index != p_index) {
+			if (entries[i].index == INVALID_INDEX) {
+				return;
+			}
+			i = (i + 1) & mask;
+		}
+
+		// Move back the entries that can't be found after the removal
+		for (size_t j = (i + 1) & mask; entries[j].index != INVALID_INDEX; j = (j + 1) & mask) {
+			size_t home = entries[j].hash & mask;
+			// `home` is not in the cyclic range (i, j]
+			if (i <= j ? (home <= i || home > j) : (home <= i && home > j)) {
+				entries[i] = entries[j];
+				i = j;
+			}
+		}
+		entries[i].index = INVALID_INDEX;
+		used--;
+	}
+
+	void clear() {
+		if (used) {
+			std::fill(entries.begin(), entries.end(), Entry{ 0, INVALID_INDEX });
+			used = 0;
+		}
+	}
+
+	size_t size() const {
+		return used;
+	}
+};
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/// Allocator of long-lived arrays. The sizes of the arrays are rounded up to a power of two,
+/// and the freed arrays are reused by the next arrays of the same size class.
+/// Small arrays are cut from large slabs, so allocating them rarely touches the system allocator.
+/// The allocator must outlive all of its blocks.
+template <typename TValue, size_t SLAB_SIZE = 16384>
+class SlabAllocator {
+	static constexpr uint8_t MAX_SIZE_CLASSES = 48;
+
+	std::vector<std::unique_ptr<TValue[]> > slabs;
+	std::vector<TValue *> free_lists[MAX_SIZE_CLASSES];
+	TValue *current_slab;
+	size_t slab_used;
+	size_t used_blocks;
+
+	static uint8_t _get_size_class(const size_t &p_count) {
+		uint8_t res = 0;
+		while (((size_t)1 << res) < p_count) {
+			res++;
+		}
+		return res;
+	}
+
+	TValue *_allocate(const uint8_t &p_class) {
+		auto &free_list = free_lists[p_class];
+		if (free_list.size()) {
+			TValue *res = free_list.back();
+			free_list.pop_back();
+			return res;
+		}
+
+		// Large arrays get their own slab
+		const size_t size = (size_t)1 << p_class;
+		if (size > SLAB_SIZE) {
+			slabs.push_back(std::unique_ptr<TValue[]>(new TValue[size]));
+			return slabs.back().get();
+		}
+
+		if (!current_slab || slab_used + size > SLAB_SIZE) {
+			slabs.push_back(std::unique_ptr<TValue[]>(new TValue[SLAB_SIZE]));
+			current_slab = slabs.back().get();
+			slab_used = 0;
+		}
+
+		TValue *res = current_slab + slab_used;
+		slab_used += size;
+		return res;
+	}
+
+	void _free(TValue *p_data, const uint8_t &p_class) {
+		free_lists[p_class].push_back(p_data);
+		used_blocks--;
+	}
+
+public:
+	/// Array allocated by SlabAllocator. Returns the memory to the allocator when destroyed.
+	class Block {
+		SlabAllocator *owner;
+		TValue *data;
+		uint8_t size_class;
+
+		friend class SlabAllocator;
+
+		Block(SlabAllocator *p_owner, TValue *p_data, const uint8_t &p_class) :
+				owner(p_owner),
+				data(p_data),
+				size_class(p_class) {
+		}
+
+	public:
+		Block() :
+				owner(nullptr),
+				data(nullptr),
+				size_class(0) {
+		}
+
+		Block(Block &&p_other) noexcept :
+				owner(p_other.owner),
+				data(p_other.data),
+				size_class(p_other.size_class) {
+			p_other.owner = nullptr;
+			p_other.data = nullptr;
+		}
+
+		Block &operator=(Block &&p_other) noexcept {
+			if (this != &p_other) {
+				reset();
+				owner = p_other.owner;
+				data = p_other.data;
+				size_class = p_other.size_class;
+				p_other.owner = nullptr;
+				p_other.data = nullptr;
+			}
+			return *this;
+		}
+
+		Block(const Block &) = delete;
+		Block &operator=(const Block &) = delete;
+
+		~Block() {
+			reset();
+		}
+
+		void reset() {
+			if (owner) {
+				owner->_free(data, size_class);
+				owner = nullptr;
+				data = nullptr;
+			}
+		}
+
+		TValue *get() const {
+			return data;
+		}
+
+		size_t size() const {
+			return owner ? (size_t)1 << size_class : 0;
+		}
+	};
+
+	SlabAllocator() :
+			current_slab(nullptr),
+			slab_used(0),
+			used_blocks(0) {
+	}
+
+	SlabAllocator(const SlabAllocator &) = delete;
+	SlabAllocator &operator=(const SlabAllocator &) = delete;
+
+	Block allocate(const size_t &p_count) {
+		uint8_t size_class = _get_size_class(p_count);
+		used_blocks++;
+		return Block(this, _allocate(size_class), size_class);
+	}
+
+	size_t get_used_blocks_count() const {
+		return used_blocks;
+	}
+
+	/// Returns the memory to the system if there are no used blocks.
+	void release_if_unused() {
+		if (used_blocks) {
+			return;
+		}
+
+		slabs.clear();
+		for (auto &f : free_lists) {
+			f.clear();
+		}
+		current_slab = nullptr;
+		slab_used = 0;
+	}
+};
@@ -0,0 +1,300 @@
+#include "dynamic_aabb_tree.h"
+#include "utils.h"
+
+int32_t DynamicAABBTree::_allocate_node() {
+	if (free_list == NULL_NODE) {
+		nodes.emplace_back();
+		Node &n = nodes.back();
+		n.parent = NULL_NODE;
+		n.child1 = NULL_NODE;
+		n.child2 = NULL_NODE;
+		n.height = 0;
+		n.item = 0;
+		return (int32_t)nodes.size() - 1;
+	}
+
+	int32_t id = free_list;
+	Node &n = nodes[id];
+	free_list = n.parent;
+	n.parent = NULL_NODE;
+	n.child1 = NULL_NODE;
+	n.child2 = NULL_NODE;
+	n.height = 0;
+	n.item = 0;
+	return id;
+}
+
+void DynamicAABBTree::_free_node(const int32_t &p_node) {
+	Node &n = nodes[p_node];
+	n.parent = free_list;
+	n.height = -1;
+	free_list = p_node;
+}
+
+int32_t DynamicAABBTree::insert(const Vector3 &p_min, const Vector3 &p_max, const uint32_t &p_item) {
+	int32_t leaf = _allocate_node();
+	Node &n = nodes[leaf];
+	n.min = p_min;
+	n.max = p_max;
+	n.item = p_item;
+	n.height = 0;
+
+	_insert_leaf(leaf);
+	leaf_count++;
+	return leaf;
+}
+
+void DynamicAABBTree::remove(const int32_t &p_leaf) {
+	_remove_leaf(p_leaf);
+	_free_node(p_leaf);
+	leaf_count--;
+}
+
+void DynamicAABBTree::clear() {
+	nodes.clear();
+	root = NULL_NODE;
+	free_list = NULL_NODE;
+	leaf_count = 0;
+}
+
+void DynamicAABBTree::_fit(const int32_t &p_node) {
+	Node &n = nodes[p_node];
+	const Node &c1 = nodes[n.child1];
+	const Node &c2 = nodes[n.child2];
+	n.min = c1.min.min(c2.min);
+	n.max = c1.max.max(c2.max);
+	n.height = 1 + Math::max(c1.height, c2.height);
+}
+
+void DynamicAABBTree::_update_parents(int32_t p_node) {
+	while (p_node != NULL_NODE) {
+		p_node = _balance(p_node);
+		_fit(p_node);
+		p_node = nodes[p_node].parent;
+	}
+}
+
+void DynamicAABBTree::_insert_leaf(const int32_t &p_leaf) {
+	if (root == NULL_NODE) {
+		root = p_leaf;
+		nodes[root].parent = NULL_NODE;
+		return;
+	}
+
+	const Vector3 leaf_min = nodes[p_leaf].min;
+	const Vector3 leaf_max = nodes[p_leaf].max;
+
+	// Find the best sibling using the surface area heuristic
+	int32_t index = root;
+	while (!nodes[index].is_leaf()) {
+		const Node &n = nodes[index];
+
+		real_t area = _get_area(n.min, n.max);
+		real_t combined_area = _get_area(n.min.min(leaf_min), n.max.max(leaf_max));
+
+		// Cost of creating a new parent for this node and the new leaf
+		real_t cost = 2 * combined_area;
+		// Minimum cost of pushing the leaf further down the tree
+		real_t inheritance_cost = 2 * (combined_area - area);
+
+		auto get_child_cost = [&](const int32_t &p_child) {
+			const Node &c = nodes[p_child];
+			real_t new_area = _get_area(c.min.min(leaf_min), c.max.max(leaf_max));
+			if (c.is_leaf()) {
+				return new_area + inheritance_cost;
+			}
+			return new_area - _get_area(c.min, c.max) + inheritance_cost;
+		};
+
+		real_t cost1 = get_child_cost(n.child1);
+		real_t cost2 = get_child_cost(n.child2);
+
+		if (cost < cost1 && cost < cost2) {
+			break;
+		}
+
+		index = cost1 < cost2 ? n.child1 : n.child2;
+	}
+
+	int32_t sibling = index;
+
+	// Create a new parent. The vector can be reallocated, so references are taken after that.
+	int32_t new_parent = _allocate_node();
+	int32_t old_parent = nodes[sibling].parent;
+	{
+		Node &np = nodes[new_parent];
+		np.parent = old_parent;
+		np.min = leaf_min.min(nodes[sibling].min);
+		np.max = leaf_max.max(nodes[sibling].max);
+		np.height = nodes[sibling].height + 1;
+		np.child1 = sibling;
+		np.child2 = p_leaf;
+	}
+
+	if (old_parent != NULL_NODE) {
+		Node &op = nodes[old_parent];
+		if (op.child1 == sibling) {
+			op.child1 = new_parent;
+		} else {
+			op.child2 = new_parent;
+		}
+	} else {
+		root = new_parent;
+	}
+
+	nodes[sibling].parent = new_parent;
+	nodes[p_leaf].parent = new_parent;
+
+	_update_parents(nodes[p_leaf].parent);
+}
+
+void DynamicAABBTree::_remove_leaf(const int32_t &p_leaf) {
+	if (p_leaf == root) {
+		root = NULL_NODE;
+		return;
+	}
+
+	int32_t parent = nodes[p_leaf].parent;
+	int32_t grand_parent = nodes[parent].parent;
+	int32_t sibling = nodes[parent].child1 == p_leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+	if (grand_parent != NULL_NODE) {
+		Node &gp = nodes[grand_parent];
+		if (gp.child1 == parent) {
+			gp.child1 = sibling;
+		} else {
+			gp.child2 = sibling;
+		}
+		nodes[sibling].parent = grand_parent;
+		_free_node(parent);
+
+		_update_parents(grand_parent);
+	} else {
+		root = sibling;
+		nodes[sibling].parent = NULL_NODE;
+		_free_node(parent);
+	}
+}
+
+// Performs a left or right rotation if node A is imbalanced.
+// Returns the new root of the subtree.
+int32_t DynamicAABBTree::_balance(const int32_t &p_node) {
+	int32_t i_a = p_node;
+	Node *a = &nodes[i_a];
+	if (a->is_leaf() || a->height < 2) {
+		return i_a;
+	}
+
+	int32_t i_b = a->child1;
+	int32_t i_c = a->child2;
+	Node *b = &nodes[i_b];
+	Node *c = &nodes[i_c];
+
+	int32_t balance = c->height - b->height;
+
+	// Rotate C up
+	if (balance > 1) {
+		int32_t i_f = c->child1;
+		int32_t i_g = c->child2;
+		Node *f = &nodes[i_f];
+		Node *g = &nodes[i_g];
+
+		// Swap A and C
+		c->child1 = i_a;
+		c->parent = a->parent;
+		a->parent = i_c;
+
+		// A's old parent should point to C
+		if (c->parent != NULL_NODE) {
+			Node &cp = nodes[c->parent];
+			if (cp.child1 == i_a) {
+				cp.child1 = i_c;
+			} else {
+				cp.child2 = i_c;
+			}
+		} else {
+			root = i_c;
+		}
+
+		// Rotate
+		if (f->height > g->height) {
+			c->child2 = i_f;
+			a->child2 = i_g;
+			g->parent = i_a;
+			a->min = b->min.min(g->min);
+			a->max = b->max.max(g->max);
+			c->min = a->min.min(f->min);
+			c->max = a->max.max(f->max);
+
+			a->height = 1 + Math::max(b->height, g->height);
+			c->height = 1 + Math::max(a->height, f->height);
+		} else {
+			c->child2 = i_g;
+			a->child2 = i_f;
+			f->parent = i_a;
+			a->min = b->min.min(f->min);
+			a->max = b->max.max(f->max);
+			c->min = a->min.min(g->min);
+			c->max = a->max.max(g->max);
+
+			a->height = 1 + Math::max(b->height, f->height);
+			c->height = 1 + Math::max(a->height, g->height);
+		}
+
+		return i_c;
+	}
+
+	// Rotate B up
+	if (balance < -1) {
+		int32_t i_d = b->child1;
+		int32_t i_e = b->child2;
+		Node *d = &nodes[i_d];
+		Node *e = &nodes[i_e];
+
+		// Swap A and B
+		b->child1 = i_a;
+		b->parent = a->parent;
+		a->parent = i_b;
+
+		// A's old parent should point to B
+		if (b->parent != NULL_NODE) {
+			Node &bp = nodes[b->parent];
+			if (bp.child1 == i_a) {
+				bp.child1 = i_b;
+			} else {
+				bp.child2 = i_b;
+			}
+		} else {
+			root = i_b;
+		}
+
+		// Rotate
+		if (d->height > e->height) {
+			b->child2 = i_d;
+			a->child1 = i_e;
+			e->parent = i_a;
+			a->min = c->min.min(e->min);
+			a->max = c->max.max(e->max);
+			b->min = a->min.min(d->min);
+			b->max = a->max.max(d->max);
+
+			a->height = 1 + Math::max(c->height, e->height);
+			b->height = 1 + Math::max(a->height, d->height);
+		} else {
+			b->child2 = i_e;
+			a->child1 = i_d;
+			d->parent = i_a;
+			a->min = c->min.min(d->min);
+			a->max = c->max.max(d->max);
+			b->min = a->min.min(e->min);
+			b->max = a->max.max(e->max);
+
+			a->height = 1 + Math::max(c->height, d->height);
+			b->height = 1 + Math::max(a->height, e->height);
+		}
+
+		return i_b;
+	}
+
+	return i_a;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "compiler.h"
+
+#include <cstdint>
+#include <vector>
+
+GODOT_WARNING_DISABLE()
+#include <godot_cpp/variant/builtin_types.hpp>
+GODOT_WARNING_RESTORE()
+using namespace godot;
+
+/// Dynamic bounding volume hierarchy (based on b2DynamicTree from Box2D).
+/// Leaves store an index of an item, the tree is kept balanced with rotations after each insertion or removal.
+class DynamicAABBTree {
+public:
+	static constexpr int32_t NULL_NODE = -1;
+
+private:
+	struct Node {
+		Vector3 min;
+		Vector3 max;
+		// Next free node if the node is in the free list
+		int32_t parent;
+		int32_t child1;
+		int32_t child2;
+		// 0 for leaves, -1 for free nodes
+		int32_t height;
+		uint32_t item;
+
+		_FORCE_INLINE_ bool is_leaf() const {
+			return child1 == NULL_NODE;
+		}
+	};
+
+	std::vector<Node> nodes;
+	int32_t root = NULL_NODE;
+	int32_t free_list = NULL_NODE;
+	size_t leaf_count = 0;
+
+	int32_t _allocate_node();
+	void _free_node(const int32_t &p_node);
+	void _insert_leaf(const int32_t &p_leaf);
+	void _remove_leaf(const int32_t &p_leaf);
+	void _update_parents(int32_t p_node);
+	int32_t _balance(const int32_t &p_node);
+	void _fit(const int32_t &p_node);
+
+	static _FORCE_INLINE_ real_t _get_area(const Vector3 &p_min, const Vector3 &p_max) {
+		Vector3 s = p_max - p_min;
+		return s.x * s.y + s.y * s.z + s.z * s.x;
+	}
+
+public:
+	/// Adds a leaf and returns its id.
+	int32_t insert(const Vector3 &p_min, const Vector3 &p_max, const uint32_t &p_item);
+	void remove(const int32_t &p_leaf);
+	void clear();
+
+	_FORCE_INLINE_ size_t get_leaf_count() const {
+		return leaf_count;
+	}
+
+	_FORCE_INLINE_ int32_t get_height() const {
+		return root == NULL_NODE ? 0 : nodes[root].height;
+	}
+
+	/// Walks the nodes for which `p_node_test(min, max)` returns true and calls `p_leaf_func(item)` for the leaves.
+	/// Returns the number of checked nodes.
+	template <class TNodeTest, class TLeafFunc>
+	size_t query(TNodeTest p_node_test, TLeafFunc p_leaf_func) const {
+		if (root == NULL_NODE) {
+			return 0;
+		}
+
+		size_t visited = 0;
+		// The height of a balanced tree is small, but the stack can still grow if needed
+		int32_t fixed_stack[64];
+		std::vector<int32_t> dynamic_stack;
+		int32_t *stack = fixed_stack;
+		size_t stack_capacity = 64;
+		size_t stack_size = 0;
+
+		stack[stack_size++] = root;
+		while (stack_size) {
+			const Node &node = nodes[stack[--stack_size]];
+			visited++;
+
+			if (!p_node_test(node.min, node.max)) {
+				continue;
+			}
+
+			if (node.is_leaf()) {
+				p_leaf_func(node.item);
+				continue;
+			}
+
+			if (stack_size + 2 > stack_capacity) {
+				// After the first spill the stack is already in `dynamic_stack` and `resize` keeps it
+				if (stack == fixed_stack) {
+					dynamic_stack.assign(fixed_stack, fixed_stack + stack_size);
+				}
+				stack_capacity *= 2;
+				dynamic_stack.resize(stack_capacity);
+				stack = dynamic_stack.data();
+			}
+			stack[stack_size++] = node.child2;
+			stack[stack_size++] = node.child1;
+		}
+		return visited;
+	}
+};
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "compiler.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+/// Keeps the delayed objects of a pool ordered by their expiration time.
+/// The objects store absolute deadlines, so only the expired and the new objects are touched when the time passes.
+/// The slots of the expired objects are kept in a free list to be reused by the new objects.
+class ExpirationQueue {
+	struct Item {
+		double deadline;
+		uint32_t index;
+
+		// Makes std::push_heap create a min-heap
+		_FORCE_INLINE_ bool operator<(const Item &p_other) const {
+			return deadline > p_other.deadline;
+		}
+	};
+
+	std::vector<Item> heap;
+	/// Objects that have not been rendered yet. They cannot expire before the first frame.
+	std::vector<uint32_t> added;
+	std::vector<uint32_t> free_slots;
+
+public:
+	_FORCE_INLINE_ size_t get_free_count() const {
+		return free_slots.size();
+	}
+
+	/// Returns the slot of an expired object if there is one
+	_FORCE_INLINE_ bool pop_free(uint32_t &r_idx) {
+		if (free_slots.empty()) {
+			return false;
+		}
+		r_idx = free_slots.back();
+		free_slots.pop_back();
+		return true;
+	}
+
+	/// Must be called after setting the deadline of a new object
+	_FORCE_INLINE_ void add(const uint32_t &p_idx) {
+		added.push_back(p_idx);
+	}
+
+	/// Removes the objects whose deadlines are earlier than `p_time` and moves the new objects to the queue.
+	/// `p_on_expired(idx)` is called for each expired object.
+	/// `p_on_first_frame(idx)` is called for each new object and must return its deadline.
+	template <class TExpired, class TFirstFrame>
+	void update(const double &p_time, TExpired p_on_expired, TFirstFrame p_on_first_frame) {
+		while (heap.size() && heap.front().deadline < p_time) {
+			uint32_t idx = heap.front().index;
+			std::pop_heap(heap.begin(), heap.end());
+			heap.pop_back();
+
+			p_on_expired(idx);
+			free_slots.push_back(idx);
+		}
+
+		for (const uint32_t &idx : added) {
+			heap.push_back({ p_on_first_frame(idx), idx });
+			std::push_heap(heap.begin(), heap.end());
+		}
+		added.clear();
+	}
+
+	/// Must be called after the objects have been moved. `p_get_state(idx, r_deadline, r_is_rendered)` returns false for the expired objects.
+	template <class TGetState>
+	void rebuild(const size_t &p_size, TGetState p_get_state) {
+		heap.clear();
+		added.clear();
+		free_slots.clear();
+
+		double deadline;
+		bool is_rendered;
+		for (size_t i = 0; i < p_size; i++) {
+			if (!p_get_state(i, deadline, is_rendered)) {
+				continue;
+			}
+
+			if (is_rendered) {
+				heap.push_back({ deadline, (uint32_t)i });
+			} else {
+				added.push_back((uint32_t)i);
+			}
+		}
+		std::make_heap(heap.begin(), heap.end());
+	}
+
+	void clear() {
+		heap.clear();
+		added.clear();
+		free_slots.clear();
+	}
+};
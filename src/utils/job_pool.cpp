@@ -0,0 +1,170 @@
+#include "job_pool.h"
+#include "utils.h"
+
+GODOT_WARNING_DISABLE()
+#include <godot_cpp/classes/os.hpp>
+GODOT_WARNING_RESTORE()
+
+#include <algorithm>
+#include <chrono>
+
+// Web builds without thread support
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define JOB_POOL_NO_THREADS
+#endif
+
+uint32_t JobPool::get_default_threads_count() {
+#ifdef JOB_POOL_NO_THREADS
+	return 0;
+#else
+	// The jobs are short, so a lot of threads will only wait for each other
+	const int max_threads = 7;
+	return (uint32_t)Math::clamp(OS::get_singleton()->get_processor_count() - 1, 0, max_threads);
+#endif
+}
+
+JobPool::JobPool(const uint32_t &p_threads) :
+		pending_jobs(0) {
+	workers.push_back(std::make_unique<Worker>());
+
+#ifndef JOB_POOL_NO_THREADS
+	for (uint32_t i = 0; i < p_threads; i++) {
+		workers.push_back(std::make_unique<Worker>());
+	}
+
+	for (uint32_t i = 1; i < workers.size(); i++) {
+		workers[i]->thread = std::thread(&JobPool::_thread_loop, this, i);
+	}
+#endif
+
+	DEV_PRINT_STD(NAMEOF(JobPool) " created with %d workers\n", (int)workers.size());
+}
+
+JobPool::~JobPool() {
+	{
+		std::lock_guard<std::mutex> lock(state_mutex);
+		is_exiting = true;
+	}
+	start_cv.notify_all();
+
+	for (auto &w : workers) {
+		if (w->thread.joinable()) {
+			w->thread.join();
+		}
+	}
+}
+
+void JobPool::_thread_loop(const uint32_t p_worker) {
+	uint64_t last_generation = 0;
+
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(state_mutex);
+			start_cv.wait(lock, [this, &last_generation] { return is_exiting || generation != last_generation; });
+			if (is_exiting) {
+				return;
+			}
+			last_generation = generation;
+		}
+
+		_work(p_worker);
+	}
+}
+
+void JobPool::_work(const uint32_t &p_worker) {
+	ZoneScoped;
+	auto published = std::chrono::steady_clock::now();
+
+	while (Job *job = _pop_job(p_worker)) {
+		(*job)(p_worker);
+
+		// The time is added before the job is marked as done, so `run` can't return before it is written.
+		// The remainder of the microsecond is kept for the next job.
+		auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - published);
+		published += elapsed;
+		workers[p_worker]->time_usec += elapsed.count();
+
+		if (pending_jobs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			std::lock_guard<std::mutex> lock(state_mutex);
+			done_cv.notify_all();
+		}
+	}
+}
+
+JobPool::Job *JobPool::_pop_job(const uint32_t &p_worker) {
+	// Own jobs are taken from the back
+	{
+		Worker *w = workers[p_worker].get();
+		std::lock_guard<std::mutex> lock(w->mutex);
+		if (w->jobs.size()) {
+			Job *job = w->jobs.back();
+			w->jobs.pop_back();
+			return job;
+		}
+	}
+
+	// Steal from the front of the other queues
+	for (size_t i = 1; i < workers.size(); i++) {
+		Worker *w = workers[(p_worker + i) % workers.size()].get();
+		std::lock_guard<std::mutex> lock(w->mutex);
+		if (w->jobs.size()) {
+			Job *job = w->jobs.front();
+			w->jobs.pop_front();
+			return job;
+		}
+	}
+
+	return nullptr;
+}
+
+void JobPool::run(std::vector<Job> &p_jobs) {
+	ZoneScoped;
+	for (auto &w : workers) {
+		w->time_usec = 0;
+	}
+
+	if (p_jobs.empty()) {
+		return;
+	}
+
+	// No need to wake up the threads
+	if (workers.size() == 1 || p_jobs.size() == 1) {
+		auto start = std::chrono::steady_clock::now();
+		for (auto &job : p_jobs) {
+			job(0);
+		}
+		workers[0]->time_usec = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+		return;
+	}
+
+	pending_jobs = p_jobs.size();
+	for (size_t i = 0; i < p_jobs.size(); i++) {
+		Worker *w = workers[i % workers.size()].get();
+		std::lock_guard<std::mutex> lock(w->mutex);
+		w->jobs.push_back(&p_jobs[i]);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(state_mutex);
+		generation++;
+	}
+	start_cv.notify_all();
+
+	_work(0);
+
+	{
+		ZoneScopedN("Wait for workers");
+		std::unique_lock<std::mutex> lock(state_mutex);
+		done_cv.wait(lock, [this] { return pending_jobs.load(std::memory_order_acquire) == 0; });
+	}
+}
+
+void JobPool::add_worker_times(std::vector<int64_t> &r_times) const {
+	if (r_times.size() < workers.size()) {
+		r_times.resize(workers.size());
+	}
+
+	for (size_t i = 0; i < workers.size(); i++) {
+		r_times[i] += workers[i]->time_usec.load();
+	}
+}
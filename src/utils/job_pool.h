@@ -0,0 +1,67 @@
+#pragma once
+
+#include "compiler.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Small pool of worker threads that executes a list of independent jobs.
+/// Each worker has its own queue and steals jobs from the others when its queue is empty.
+/// The calling thread is also used as the worker with index 0.
+class JobPool {
+public:
+	/// Receives the index of the worker that executes the job.
+	typedef std::function<void(const uint32_t &p_worker)> Job;
+
+private:
+	struct Worker {
+		std::mutex mutex;
+		std::deque<Job *> jobs;
+		std::atomic<int64_t> time_usec;
+		std::thread thread;
+
+		Worker() :
+				time_usec(0) {}
+	};
+
+	std::vector<std::unique_ptr<Worker> > workers;
+
+	std::mutex state_mutex;
+	std::condition_variable start_cv;
+	std::condition_variable done_cv;
+	uint64_t generation = 0;
+	bool is_exiting = false;
+	std::atomic<size_t> pending_jobs;
+
+	void _thread_loop(const uint32_t p_worker);
+	void _work(const uint32_t &p_worker);
+	Job *_pop_job(const uint32_t &p_worker);
+
+public:
+	/// Returns the number of additional threads that should be created on this machine.
+	static uint32_t get_default_threads_count();
+
+	JobPool(const uint32_t &p_threads);
+	~JobPool();
+
+	JobPool(const JobPool &) = delete;
+	JobPool &operator=(const JobPool &) = delete;
+
+	/// Returns the number of workers including the calling thread.
+	_FORCE_INLINE_ uint32_t get_workers_count() const {
+		return (uint32_t)workers.size();
+	}
+
+	/// Executes all jobs and waits for them to finish. Must be called by only one thread at a time.
+	void run(std::vector<Job> &p_jobs);
+
+	/// Adds the time in microseconds spent by each worker during the last `run` to `r_times`.
+	void add_worker_times(std::vector<int64_t> &r_times) const;
+};
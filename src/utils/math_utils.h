@@ -3,6 +3,7 @@
 #include "compiler.h"
 
 #include <array>
+#include <cstring>
 #include <functional>
 
 GODOT_WARNING_DISABLE()
@@ -27,6 +28,16 @@ public:
 	_FORCE_INLINE_ static real_t get_max_vector_length(const Vector3 &p_a, const Vector3 &p_b, const Vector3 &p_c);
 	_FORCE_INLINE_ static real_t get_max_basis_length(const Basis &p_b);
 	_FORCE_INLINE_ static AABB calculate_vertex_bounds(const Vector3 *p_lines, size_t p_count);
+	/// Returns a basis whose -Z axis points along `p_dir`, like Basis::looking_at, but without an up vector and its special cases.
+	/// X and Y are scaled by `p_scale_xy`, Z is scaled by `p_scale_z`.
+	_FORCE_INLINE_ static Basis get_direction_basis(const Vector3 &p_dir, const real_t &p_scale_xy, const real_t &p_scale_z);
+	/// Too small values are flushed to zero, too large values and NaN are clamped to the max half float value.
+	_FORCE_INLINE_ static uint16_t float_to_half(const float &p_value);
+	/// Packs two half floats in the same way as `packHalf2x16` in shaders.
+	_FORCE_INLINE_ static uint32_t pack_half2(const float &p_x, const float &p_y);
+	_FORCE_INLINE_ static float half_to_float(const uint16_t &p_value);
+	/// Unpacks 4 half floats packed by `pack_half2` into two words whose bits are stored in `p_xy` and `p_zw`.
+	_FORCE_INLINE_ static Color unpack_half4(const float &p_xy, const float &p_zw);
 
 	_FORCE_INLINE_ static std::array<Vector3, 8> get_frustum_cube(const std::array<Plane, 6> p_frustum);
 	_FORCE_INLINE_ static void scale_frustum_far_plane_distance(std::array<Plane, 6> &p_frustum, const Transform3D &p_camera_xf, const real_t &p_scale);
@@ -156,6 +167,76 @@ AABB MathUtils::calculate_vertex_bounds(const Vector3 *p_lines, size_t p_count)
 	}
 }
 
+Basis MathUtils::get_direction_basis(const Vector3 &p_dir, const real_t &p_scale_xy, const real_t &p_scale_z) {
+	const real_t len_sq = p_dir.length_squared();
+	const Vector3 z = len_sq > 0 ? p_dir * (-1 / Math::sqrt(len_sq)) : Vector3(0, 0, 1);
+
+	// Orthonormal basis from a unit vector without branches on the direction.
+	// "Building an Orthonormal Basis, Revisited", Duff et al. 2017
+	const real_t sign = z.z >= 0 ? 1 : -1;
+	const real_t a = -1 / (sign + z.z);
+	const real_t b = z.x * z.y * a;
+	const Vector3 x(1 + sign * z.x * z.x * a, sign * b, -sign * z.x);
+	const Vector3 y(b, sign + z.y * z.y * a, -z.y);
+
+	return Basis(x * p_scale_xy, y * p_scale_xy, z * p_scale_z);
+}
+
+uint16_t MathUtils::float_to_half(const float &p_value) {
+	uint32_t x;
+	memcpy(&x, &p_value, sizeof(x));
+	const uint32_t sign = (x >> 16) & 0x8000;
+	const int32_t exp = (int32_t)((x >> 23) & 0xff) - 127 + 15;
+	const uint32_t mantissa = x & 0x7fffff;
+
+	if (exp <= 0) {
+		return (uint16_t)sign;
+	}
+
+	// Infinity is never produced, so the packed values cannot be interpreted as NaN floats
+	if (exp >= 31) {
+		return (uint16_t)(sign | 0x7bff);
+	}
+
+	// Round to the nearest. The carry can move the value to the next exponent.
+	uint32_t res = (((uint32_t)exp << 10) | (mantissa >> 13)) + ((mantissa >> 12) & 1);
+	if (res > 0x7bff) {
+		res = 0x7bff;
+	}
+	return (uint16_t)(sign | res);
+}
+
+uint32_t MathUtils::pack_half2(const float &p_x, const float &p_y) {
+	return (uint32_t)float_to_half(p_x) | ((uint32_t)float_to_half(p_y) << 16);
+}
+
+float MathUtils::half_to_float(const uint16_t &p_value) {
+	const uint32_t sign = ((uint32_t)p_value & 0x8000) << 16;
+	const uint32_t exp = ((uint32_t)p_value >> 10) & 0x1f;
+	const uint32_t mantissa = (uint32_t)p_value & 0x3ff;
+
+	uint32_t x;
+	if (exp == 0) {
+		// Zero. Subnormal values are never produced by `float_to_half`
+		x = sign;
+	} else if (exp == 31) {
+		x = sign | 0x7f800000 | (mantissa << 13);
+	} else {
+		x = sign | ((exp - 15 + 127) << 23) | (mantissa << 13);
+	}
+
+	float res;
+	memcpy(&res, &x, sizeof(res));
+	return res;
+}
+
+Color MathUtils::unpack_half4(const float &p_xy, const float &p_zw) {
+	uint32_t xy, zw;
+	memcpy(&xy, &p_xy, sizeof(xy));
+	memcpy(&zw, &p_zw, sizeof(zw));
+	return Color(half_to_float((uint16_t)(xy & 0xffff)), half_to_float((uint16_t)(xy >> 16)), half_to_float((uint16_t)(zw & 0xffff)), half_to_float((uint16_t)(zw >> 16)));
+}
+
 std::array<Vector3, 8> MathUtils::get_frustum_cube(const std::array<Plane, 6> p_frustum) {
 	std::function<Vector3(const Plane &, const Plane &, const Plane &)> intersect_planes = [&](const Plane &a, const Plane &b, const Plane &c) {
 		Vector3 intersec_result;
@@ -0,0 +1,220 @@
+#include "occlusion_buffer.h"
+#include "math_utils.h"
+
+#include <algorithm>
+#include <cmath>
+
+void OcclusionBuffer::clear(const Projection &p_view_projection, const int32_t &p_width, const int32_t &p_height) {
+	view_projection = p_view_projection;
+	is_pyramid_built = false;
+
+	int32_t w = std::max(p_width, 1);
+	int32_t h = std::max(p_height, 1);
+
+	size_t count = 1;
+	for (int32_t lw = w, lh = h; lw > 1 || lh > 1; lw = (lw + 1) / 2, lh = (lh + 1) / 2) {
+		count++;
+	}
+	levels.resize(count);
+
+	for (Level &l : levels) {
+		l.width = w;
+		l.height = h;
+		l.depth.assign((size_t)w * h, EMPTY_DEPTH);
+		w = (w + 1) / 2;
+		h = (h + 1) / 2;
+	}
+}
+
+void OcclusionBuffer::_draw_triangle(const Vector3 &p_a, const Vector3 &p_b, const Vector3 &p_c) {
+	Level &l = levels[0];
+
+	real_t area = (p_b.x - p_a.x) * (p_c.y - p_a.y) - (p_b.y - p_a.y) * (p_c.x - p_a.x);
+	if (Math::abs(area) < (real_t)1e-8) {
+		return;
+	}
+	// Occluders are visible from both sides
+	real_t sign = area > 0 ? (real_t)1 : (real_t)-1;
+	real_t inv_area = 1 / area;
+
+	int32_t min_x = std::max((int32_t)Math::floor(std::min({ p_a.x, p_b.x, p_c.x })), 0);
+	int32_t min_y = std::max((int32_t)Math::floor(std::min({ p_a.y, p_b.y, p_c.y })), 0);
+	int32_t max_x = std::min((int32_t)Math::ceil(std::max({ p_a.x, p_b.x, p_c.x })), l.width - 1);
+	int32_t max_y = std::min((int32_t)Math::ceil(std::max({ p_a.y, p_b.y, p_c.y })), l.height - 1);
+
+	for (int32_t y = min_y; y <= max_y; y++) {
+		real_t py = y + (real_t)0.5;
+		float *row = l.depth.data() + (size_t)y * l.width;
+
+		for (int32_t x = min_x; x <= max_x; x++) {
+			real_t px = x + (real_t)0.5;
+
+			real_t w0 = (p_c.x - p_b.x) * (py - p_b.y) - (p_c.y - p_b.y) * (px - p_b.x);
+			real_t w1 = (p_a.x - p_c.x) * (py - p_c.y) - (p_a.y - p_c.y) * (px - p_c.x);
+			real_t w2 = (p_b.x - p_a.x) * (py - p_a.y) - (p_b.y - p_a.y) * (px - p_a.x);
+			if (w0 * sign < 0 || w1 * sign < 0 || w2 * sign < 0) {
+				continue;
+			}
+
+			// Normalized device depth is linear in screen space
+			float depth = (float)((w0 * p_a.z + w1 * p_b.z + w2 * p_c.z) * inv_area);
+			if (depth < row[x]) {
+				row[x] = depth;
+			}
+		}
+	}
+}
+
+void OcclusionBuffer::add_triangles(const Vector3 *p_vertices, const size_t &p_count) {
+	if (levels.empty()) {
+		return;
+	}
+
+	is_pyramid_built = false;
+
+	for (size_t t = 0; t + 2 < p_count; t += 3) {
+		Vector4 in[3] = { _to_clip(p_vertices[t]), _to_clip(p_vertices[t + 1]), _to_clip(p_vertices[t + 2]) };
+
+		// Clip by the near plane: z >= -w
+		Vector4 poly[4];
+		int poly_count = 0;
+		for (int i = 0; i < 3; i++) {
+			const Vector4 &a = in[i];
+			const Vector4 &b = in[(i + 1) % 3];
+			real_t da = a.z + a.w;
+			real_t db = b.z + b.w;
+
+			if (da >= 0) {
+				poly[poly_count++] = a;
+			}
+			if ((da >= 0) != (db >= 0)) {
+				poly[poly_count++] = a + (b - a) * (da / (da - db));
+			}
+		}
+
+		if (poly_count < 3) {
+			continue;
+		}
+
+		Vector3 screen[4];
+		bool is_valid = true;
+		for (int i = 0; i < poly_count; i++) {
+			if (poly[i].w <= 0) {
+				is_valid = false;
+				break;
+			}
+			screen[i] = _to_screen(poly[i]);
+		}
+
+		if (!is_valid) {
+			continue;
+		}
+
+		for (int i = 1; i < poly_count - 1; i++) {
+			_draw_triangle(screen[0], screen[i], screen[i + 1]);
+		}
+	}
+}
+
+void OcclusionBuffer::build_pyramid() {
+	for (size_t i = 1; i < levels.size(); i++) {
+		const Level &src = levels[i - 1];
+		Level &dst = levels[i];
+
+		for (int32_t y = 0; y < dst.height; y++) {
+			int32_t y0 = y * 2;
+			int32_t y1 = std::min(y0 + 1, src.height - 1);
+			const float *row0 = src.depth.data() + (size_t)y0 * src.width;
+			const float *row1 = src.depth.data() + (size_t)y1 * src.width;
+
+			for (int32_t x = 0; x < dst.width; x++) {
+				int32_t x0 = x * 2;
+				int32_t x1 = std::min(x0 + 1, src.width - 1);
+				dst.depth[(size_t)y * dst.width + x] = std::max({ row0[x0], row0[x1], row1[x0], row1[x1] });
+			}
+		}
+	}
+	is_pyramid_built = true;
+}
+
+bool OcclusionBuffer::is_occluded(const AABBMinMax &p_bounds) const {
+	if (!is_pyramid_built) {
+		return false;
+	}
+
+	const Level &l0 = levels[0];
+	real_t min_x = (real_t)INFINITY, min_y = (real_t)INFINITY, min_depth = (real_t)INFINITY;
+	real_t max_x = -(real_t)INFINITY, max_y = -(real_t)INFINITY;
+
+	for (int i = 0; i < 8; i++) {
+		Vector3 corner(
+				(i & 1) ? p_bounds.max.x : p_bounds.min.x,
+				(i & 2) ? p_bounds.max.y : p_bounds.min.y,
+				(i & 4) ? p_bounds.max.z : p_bounds.min.z);
+
+		Vector4 clip = _to_clip(corner);
+		if (clip.w <= 0 || clip.z < -clip.w) {
+			return false;
+		}
+
+		Vector3 s = _to_screen(clip);
+		min_x = Math::min(min_x, s.x);
+		min_y = Math::min(min_y, s.y);
+		max_x = Math::max(max_x, s.x);
+		max_y = Math::max(max_y, s.y);
+		min_depth = Math::min(min_depth, s.z);
+	}
+
+	if (max_x < 0 || max_y < 0 || min_x >= l0.width || min_y >= l0.height) {
+		return false;
+	}
+
+	// Extended by a texel, because the occluders only cover the centers of the texels
+	int32_t x0 = std::max((int32_t)Math::floor(min_x) - 1, 0);
+	int32_t y0 = std::max((int32_t)Math::floor(min_y) - 1, 0);
+	int32_t x1 = std::min((int32_t)Math::floor(max_x) + 1, l0.width - 1);
+	int32_t y1 = std::min((int32_t)Math::floor(max_y) + 1, l0.height - 1);
+
+	// The level where the bounds cover no more than 2x2 texels
+	size_t level = 0;
+	while (level < levels.size() - 1 && (x1 - x0 > 1 || y1 - y0 > 1)) {
+		x0 >>= 1;
+		y0 >>= 1;
+		x1 >>= 1;
+		y1 >>= 1;
+		level++;
+	}
+
+	float max_depth = -EMPTY_DEPTH;
+	for (int32_t y = y0; y <= y1; y++) {
+		for (int32_t x = x0; x <= x1; x++) {
+			max_depth = std::max(max_depth, get_depth(x, y, level));
+		}
+	}
+
+	return min_depth > max_depth;
+}
+
+void OcclusionBuffer::append_box_triangles(const AABB &p_box, std::vector<Vector3> &r_vertices) {
+	// Corner `i` uses the max value on the axis if the bit of the axis is set
+	static const uint8_t faces[6][4] = {
+		{ 0, 2, 6, 4 }, // -X
+		{ 1, 5, 7, 3 }, // +X
+		{ 0, 4, 5, 1 }, // -Y
+		{ 2, 3, 7, 6 }, // +Y
+		{ 0, 1, 3, 2 }, // -Z
+		{ 4, 6, 7, 5 }, // +Z
+	};
+
+	Vector3 min = p_box.position;
+	Vector3 max = p_box.position + p_box.size;
+	Vector3 corners[8];
+	for (int i = 0; i < 8; i++) {
+		corners[i] = Vector3((i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y, (i & 4) ? max.z : min.z);
+	}
+
+	r_vertices.reserve(r_vertices.size() + 36);
+	for (const auto &f : faces) {
+		r_vertices.insert(r_vertices.end(), { corners[f[0]], corners[f[1]], corners[f[2]], corners[f[0]], corners[f[2]], corners[f[3]] });
+	}
+}
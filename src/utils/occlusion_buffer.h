@@ -0,0 +1,86 @@
+#pragma once
+
+#include "compiler.h"
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+GODOT_WARNING_DISABLE()
+#include <godot_cpp/variant/builtin_types.hpp>
+GODOT_WARNING_RESTORE()
+using namespace godot;
+
+struct AABBMinMax;
+
+/// Low resolution depth buffer for the occlusion culling on the CPU.
+/// Occluders are rasterized as triangles at the centers of the texels, then a hierarchical-Z pyramid is built
+/// so that any bounds can be tested by reading at most 4 texels.
+/// Does not use the RenderingServer, so it also works in headless mode.
+class OcclusionBuffer {
+public:
+	static constexpr int32_t DEFAULT_WIDTH = 256;
+	/// Depth of the texels without occluders
+	static constexpr float EMPTY_DEPTH = std::numeric_limits<float>::max();
+
+private:
+	struct Level {
+		int32_t width;
+		int32_t height;
+		// Normalized device depth. The higher levels store the farthest depth of 2x2 texels of the previous level.
+		std::vector<float> depth;
+	};
+
+	Projection view_projection;
+	std::vector<Level> levels;
+	bool is_pyramid_built = false;
+
+	_FORCE_INLINE_ Vector4 _to_clip(const Vector3 &p_pos) const {
+		const Vector4 *c = view_projection.columns;
+		return c[0] * p_pos.x + c[1] * p_pos.y + c[2] * p_pos.z + c[3];
+	}
+
+	/// Converts a clip space position in front of the near plane to the texel coordinates and depth.
+	_FORCE_INLINE_ Vector3 _to_screen(const Vector4 &p_clip) const {
+		real_t inv_w = 1 / p_clip.w;
+		return Vector3(
+				(p_clip.x * inv_w * 0.5f + 0.5f) * levels[0].width,
+				(0.5f - p_clip.y * inv_w * 0.5f) * levels[0].height,
+				p_clip.z * inv_w);
+	}
+
+	void _draw_triangle(const Vector3 &p_a, const Vector3 &p_b, const Vector3 &p_c);
+
+public:
+	/// Clears the buffer and sets the camera. `p_view_projection` is the projection multiplied by the inverse transform of the camera.
+	void clear(const Projection &p_view_projection, const int32_t &p_width, const int32_t &p_height);
+	/// Rasterizes the triangles in world space. `p_count` is the number of vertices.
+	/// Triangles crossing the near plane are clipped.
+	void add_triangles(const Vector3 *p_vertices, const size_t &p_count);
+	/// Must be called after adding all occluders and before is_occluded.
+	void build_pyramid();
+
+	/// Returns true if the bounds are entirely behind the occluders.
+	/// Bounds outside the screen or crossing the near plane are never occluded.
+	bool is_occluded(const AABBMinMax &p_bounds) const;
+
+	_FORCE_INLINE_ int32_t get_width() const {
+		return levels.size() ? levels[0].width : 0;
+	}
+
+	_FORCE_INLINE_ int32_t get_height() const {
+		return levels.size() ? levels[0].height : 0;
+	}
+
+	_FORCE_INLINE_ size_t get_levels_count() const {
+		return levels.size();
+	}
+
+	_FORCE_INLINE_ float get_depth(const int32_t &p_x, const int32_t &p_y, const size_t &p_level = 0) const {
+		const Level &l = levels[p_level];
+		return l.depth[(size_t)p_y * l.width + p_x];
+	}
+
+	/// Adds 12 triangles of the box to `r_vertices`.
+	static void append_box_triangles(const AABB &p_box, std::vector<Vector3> &r_vertices);
+};
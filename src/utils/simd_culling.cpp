@@ -0,0 +1,424 @@
+#include "simd_culling.h"
+#include "math_utils.h"
+#include "utils.h"
+
+#include <algorithm>
+
+#ifdef DEV_ENABLED
+#include <random>
+#endif
+
+// SIMD kernels work with float values only
+#ifndef REAL_T_IS_DOUBLE
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CULLING_SSE2
+#include <emmintrin.h>
+
+// AVX2 is selected at runtime, so the library can still be used on older CPUs
+#if !defined(__EMSCRIPTEN__) && (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86))
+#define CULLING_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define CULLING_AVX2_FUNC
+#else
+#define CULLING_AVX2_FUNC __attribute__((target("avx2")))
+#endif
+#endif
+
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define CULLING_NEON
+#include <arm_neon.h>
+#endif
+
+#endif
+
+CullingVolumes::CullingVolumes(const std::vector<AABBMinMax> &p_boxes, const std::vector<std::array<Plane, 6> > &p_frustums) {
+	boxes_count = p_boxes.size();
+	frustums_count = p_frustums.size();
+
+	boxes.reserve(boxes_count * 6);
+	for (const auto &b : p_boxes) {
+		boxes.insert(boxes.end(), { b.min.x, b.min.y, b.min.z, b.max.x, b.max.y, b.max.z });
+	}
+
+	planes.reserve(frustums_count * 6 * 4);
+	for (const auto &f : p_frustums) {
+		for (const auto &p : f) {
+			planes.insert(planes.end(), { p.normal.x, p.normal.y, p.normal.z, p.d });
+		}
+	}
+}
+
+#pragma region Kernels
+
+static void _cull_spheres_scalar(const real_t *p_x, const real_t *p_y, const real_t *p_z, const real_t *p_radius, const size_t &p_begin, const size_t &p_count, const CullingVolumes &p_volumes, uint64_t *r_mask) {
+	const real_t *boxes = p_volumes.boxes.data();
+	const real_t *planes = p_volumes.planes.data();
+
+	for (size_t i = p_begin; i < p_count; i++) {
+		const real_t x = p_x[i];
+		const real_t y = p_y[i];
+		const real_t z = p_z[i];
+		const real_t r = p_radius[i];
+
+		bool is_visible = false;
+		for (size_t b = 0; b < p_volumes.boxes_count; b++) {
+			const real_t *box = boxes + b * 6;
+			if (x - r < box[3] && x + r > box[0] &&
+					y - r < box[4] && y + r > box[1] &&
+					z - r < box[5] && z + r > box[2]) {
+				is_visible = true;
+				break;
+			}
+		}
+
+		if (is_visible && p_volumes.frustums_count) {
+			is_visible = false;
+			for (size_t f = 0; f < p_volumes.frustums_count && !is_visible; f++) {
+				const real_t *plane = planes + f * 24;
+				is_visible = true;
+				for (int p = 0; p < 6; p++, plane += 4) {
+					if (r < plane[0] * x + plane[1] * y + plane[2] * z - plane[3]) {
+						is_visible = false;
+						break;
+					}
+				}
+			}
+		}
+
+		if (is_visible) {
+			r_mask[i >> 6] |= 1ull << (i & 63);
+		}
+	}
+}
+
+#ifdef CULLING_SSE2
+// Returns the number of processed spheres
+static size_t _cull_spheres_sse2(const float *p_x, const float *p_y, const float *p_z, const float *p_radius, const size_t &p_count, const CullingVolumes &p_volumes, uint64_t *r_mask) {
+	const float *boxes = p_volumes.boxes.data();
+	const float *planes = p_volumes.planes.data();
+	const __m128 all_bits = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+	size_t i = 0;
+	for (; i + 4 <= p_count; i += 4) {
+		const __m128 x = _mm_loadu_ps(p_x + i);
+		const __m128 y = _mm_loadu_ps(p_y + i);
+		const __m128 z = _mm_loadu_ps(p_z + i);
+		const __m128 r = _mm_loadu_ps(p_radius + i);
+
+		const __m128 min_x = _mm_sub_ps(x, r);
+		const __m128 min_y = _mm_sub_ps(y, r);
+		const __m128 min_z = _mm_sub_ps(z, r);
+		const __m128 max_x = _mm_add_ps(x, r);
+		const __m128 max_y = _mm_add_ps(y, r);
+		const __m128 max_z = _mm_add_ps(z, r);
+
+		__m128 in_boxes = _mm_setzero_ps();
+		for (size_t b = 0; b < p_volumes.boxes_count; b++) {
+			const float *box = boxes + b * 6;
+			__m128 t = _mm_and_ps(_mm_cmplt_ps(min_x, _mm_set1_ps(box[3])), _mm_cmpgt_ps(max_x, _mm_set1_ps(box[0])));
+			t = _mm_and_ps(t, _mm_and_ps(_mm_cmplt_ps(min_y, _mm_set1_ps(box[4])), _mm_cmpgt_ps(max_y, _mm_set1_ps(box[1]))));
+			t = _mm_and_ps(t, _mm_and_ps(_mm_cmplt_ps(min_z, _mm_set1_ps(box[5])), _mm_cmpgt_ps(max_z, _mm_set1_ps(box[2]))));
+			in_boxes = _mm_or_ps(in_boxes, t);
+		}
+
+		uint64_t bits = (uint64_t)_mm_movemask_ps(in_boxes);
+		if (bits && p_volumes.frustums_count) {
+			__m128 in_frustums = _mm_setzero_ps();
+			for (size_t f = 0; f < p_volumes.frustums_count; f++) {
+				const float *plane = planes + f * 24;
+				__m128 inside = all_bits;
+				for (int p = 0; p < 6; p++, plane += 4) {
+					__m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane[0])), _mm_mul_ps(y, _mm_set1_ps(plane[1]))), _mm_mul_ps(z, _mm_set1_ps(plane[2])));
+					dist = _mm_sub_ps(dist, _mm_set1_ps(plane[3]));
+					inside = _mm_and_ps(inside, _mm_cmple_ps(dist, r));
+				}
+				in_frustums = _mm_or_ps(in_frustums, inside);
+			}
+			bits &= (uint64_t)_mm_movemask_ps(in_frustums);
+		}
+
+		r_mask[i >> 6] |= bits << (i & 63);
+	}
+	return i;
+}
+#endif
+
+#ifdef CULLING_AVX2
+CULLING_AVX2_FUNC static size_t _cull_spheres_avx2(const float *p_x, const float *p_y, const float *p_z, const float *p_radius, const size_t &p_count, const CullingVolumes &p_volumes, uint64_t *r_mask) {
+	const float *boxes = p_volumes.boxes.data();
+	const float *planes = p_volumes.planes.data();
+	const __m256 all_bits = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+	size_t i = 0;
+	for (; i + 8 <= p_count; i += 8) {
+		const __m256 x = _mm256_loadu_ps(p_x + i);
+		const __m256 y = _mm256_loadu_ps(p_y + i);
+		const __m256 z = _mm256_loadu_ps(p_z + i);
+		const __m256 r = _mm256_loadu_ps(p_radius + i);
+
+		const __m256 min_x = _mm256_sub_ps(x, r);
+		const __m256 min_y = _mm256_sub_ps(y, r);
+		const __m256 min_z = _mm256_sub_ps(z, r);
+		const __m256 max_x = _mm256_add_ps(x, r);
+		const __m256 max_y = _mm256_add_ps(y, r);
+		const __m256 max_z = _mm256_add_ps(z, r);
+
+		__m256 in_boxes = _mm256_setzero_ps();
+		for (size_t b = 0; b < p_volumes.boxes_count; b++) {
+			const float *box = boxes + b * 6;
+			__m256 t = _mm256_and_ps(_mm256_cmp_ps(min_x, _mm256_broadcast_ss(box + 3), _CMP_LT_OQ), _mm256_cmp_ps(max_x, _mm256_broadcast_ss(box + 0), _CMP_GT_OQ));
+			t = _mm256_and_ps(t, _mm256_and_ps(_mm256_cmp_ps(min_y, _mm256_broadcast_ss(box + 4), _CMP_LT_OQ), _mm256_cmp_ps(max_y, _mm256_broadcast_ss(box + 1), _CMP_GT_OQ)));
+			t = _mm256_and_ps(t, _mm256_and_ps(_mm256_cmp_ps(min_z, _mm256_broadcast_ss(box + 5), _CMP_LT_OQ), _mm256_cmp_ps(max_z, _mm256_broadcast_ss(box + 2), _CMP_GT_OQ)));
+			in_boxes = _mm256_or_ps(in_boxes, t);
+		}
+
+		uint64_t bits = (uint64_t)_mm256_movemask_ps(in_boxes);
+		if (bits && p_volumes.frustums_count) {
+			__m256 in_frustums = _mm256_setzero_ps();
+			for (size_t f = 0; f < p_volumes.frustums_count; f++) {
+				const float *plane = planes + f * 24;
+				__m256 inside = all_bits;
+				for (int p = 0; p < 6; p++, plane += 4) {
+					__m256 dist = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_broadcast_ss(plane + 0)), _mm256_mul_ps(y, _mm256_broadcast_ss(plane + 1))), _mm256_mul_ps(z, _mm256_broadcast_ss(plane + 2)));
+					dist = _mm256_sub_ps(dist, _mm256_broadcast_ss(plane + 3));
+					inside = _mm256_and_ps(inside, _mm256_cmp_ps(dist, r, _CMP_LE_OQ));
+				}
+				in_frustums = _mm256_or_ps(in_frustums, inside);
+			}
+			bits &= (uint64_t)_mm256_movemask_ps(in_frustums);
+		}
+
+		r_mask[i >> 6] |= bits << (i & 63);
+	}
+	return i;
+}
+
+static bool _is_avx2_supported() {
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	// OSXSAVE and AVX
+	__cpuid(info, 1);
+	if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)
+		return false;
+
+	// YMM registers are saved by the OS
+	if ((_xgetbv(0) & 6) != 6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+#ifdef CULLING_NEON
+static _FORCE_INLINE_ uint64_t _neon_movemask(const uint32x4_t &p_mask) {
+	static const int32_t shifts[4] = { 0, 1, 2, 3 };
+	return vaddvq_u32(vshlq_u32(vshrq_n_u32(p_mask, 31), vld1q_s32(shifts)));
+}
+
+static size_t _cull_spheres_neon(const float *p_x, const float *p_y, const float *p_z, const float *p_radius, const size_t &p_count, const CullingVolumes &p_volumes, uint64_t *r_mask) {
+	const float *boxes = p_volumes.boxes.data();
+	const float *planes = p_volumes.planes.data();
+
+	size_t i = 0;
+	for (; i + 4 <= p_count; i += 4) {
+		const float32x4_t x = vld1q_f32(p_x + i);
+		const float32x4_t y = vld1q_f32(p_y + i);
+		const float32x4_t z = vld1q_f32(p_z + i);
+		const float32x4_t r = vld1q_f32(p_radius + i);
+
+		const float32x4_t min_x = vsubq_f32(x, r);
+		const float32x4_t min_y = vsubq_f32(y, r);
+		const float32x4_t min_z = vsubq_f32(z, r);
+		const float32x4_t max_x = vaddq_f32(x, r);
+		const float32x4_t max_y = vaddq_f32(y, r);
+		const float32x4_t max_z = vaddq_f32(z, r);
+
+		uint32x4_t in_boxes = vdupq_n_u32(0);
+		for (size_t b = 0; b < p_volumes.boxes_count; b++) {
+			const float *box = boxes + b * 6;
+			uint32x4_t t = vandq_u32(vcltq_f32(min_x, vdupq_n_f32(box[3])), vcgtq_f32(max_x, vdupq_n_f32(box[0])));
+			t = vandq_u32(t, vandq_u32(vcltq_f32(min_y, vdupq_n_f32(box[4])), vcgtq_f32(max_y, vdupq_n_f32(box[1]))));
+			t = vandq_u32(t, vandq_u32(vcltq_f32(min_z, vdupq_n_f32(box[5])), vcgtq_f32(max_z, vdupq_n_f32(box[2]))));
+			in_boxes = vorrq_u32(in_boxes, t);
+		}
+
+		uint64_t bits = _neon_movemask(in_boxes);
+		if (bits && p_volumes.frustums_count) {
+			uint32x4_t in_frustums = vdupq_n_u32(0);
+			for (size_t f = 0; f < p_volumes.frustums_count; f++) {
+				const float *plane = planes + f * 24;
+				uint32x4_t inside = vdupq_n_u32(0xFFFFFFFF);
+				for (int p = 0; p < 6; p++, plane += 4) {
+					float32x4_t dist = vmulq_n_f32(x, plane[0]);
+					dist = vmlaq_n_f32(dist, y, plane[1]);
+					dist = vmlaq_n_f32(dist, z, plane[2]);
+					dist = vsubq_f32(dist, vdupq_n_f32(plane[3]));
+					inside = vandq_u32(inside, vcleq_f32(dist, r));
+				}
+				in_frustums = vorrq_u32(in_frustums, inside);
+			}
+			bits &= _neon_movemask(in_frustums);
+		}
+
+		r_mask[i >> 6] |= bits << (i & 63);
+	}
+	return i;
+}
+#endif
+
+#pragma endregion
+
+void CullingUtils::cull_spheres(const real_t *p_x, const real_t *p_y, const real_t *p_z, const real_t *p_radius, const size_t &p_count, const CullingVolumes &p_volumes, uint64_t *r_mask) {
+	ZoneScoped;
+	std::fill(r_mask, r_mask + get_mask_size(p_count), 0);
+	size_t processed = 0;
+
+#ifdef CULLING_AVX2
+	static const bool is_avx2_supported = _is_avx2_supported();
+	if (is_avx2_supported) {
+		processed = _cull_spheres_avx2(p_x, p_y, p_z, p_radius, p_count, p_volumes, r_mask);
+	} else {
+		processed = _cull_spheres_sse2(p_x, p_y, p_z, p_radius, p_count, p_volumes, r_mask);
+	}
+#elif defined(CULLING_SSE2)
+	processed = _cull_spheres_sse2(p_x, p_y, p_z, p_radius, p_count, p_volumes, r_mask);
+#elif defined(CULLING_NEON)
+	processed = _cull_spheres_neon(p_x, p_y, p_z, p_radius, p_count, p_volumes, r_mask);
+#endif
+
+	_cull_spheres_scalar(p_x, p_y, p_z, p_radius, processed, p_count, p_volumes, r_mask);
+}
+
+void CullingUtils::cull_spheres_scalar(const real_t *p_x, const real_t *p_y, const real_t *p_z, const real_t *p_radius, const size_t &p_count, const CullingVolumes &p_volumes, uint64_t *r_mask) {
+	ZoneScoped;
+	std::fill(r_mask, r_mask + get_mask_size(p_count), 0);
+	_cull_spheres_scalar(p_x, p_y, p_z, p_radius, 0, p_count, p_volumes, r_mask);
+}
+
+CullingUtils::KernelType CullingUtils::get_kernel_type() {
+#ifdef CULLING_AVX2
+	static const bool is_avx2_supported = _is_avx2_supported();
+	return is_avx2_supported ? KERNEL_AVX2 : KERNEL_SSE2;
+#elif defined(CULLING_SSE2)
+	return KERNEL_SSE2;
+#elif defined(CULLING_NEON)
+	return KERNEL_NEON;
+#else
+	return KERNEL_SCALAR;
+#endif
+}
+
+const char *CullingUtils::get_kernel_name() {
+	switch (get_kernel_type()) {
+		case KERNEL_SSE2:
+			return "SSE2";
+		case KERNEL_AVX2:
+			return "AVX2";
+		case KERNEL_NEON:
+			return "NEON";
+		case KERNEL_SCALAR:
+		default:
+			return "Scalar";
+	}
+}
+
+#ifdef DEV_ENABLED
+Dictionary CullingUtils::benchmark(const int &p_count, const int &p_iterations) {
+	size_t count = (size_t)Math::max(p_count, 1);
+	DevBenchmark bench(p_iterations);
+
+	// A camera at the origin looking at -Z. Spheres are placed around it, so only some of them are visible.
+	Projection proj = Projection::create_perspective(75, 16.f / 9.f, 0.05f, 100);
+	auto proj_planes = proj.get_projection_planes(Transform3D());
+	std::array<Plane, 6> frustum;
+	for (int i = 0; i < 6; i++)
+		frustum[i] = proj_planes[i];
+
+	auto cube = MathUtils::get_frustum_cube(frustum);
+	std::vector<std::array<Plane, 6> > frustums = { frustum };
+	std::vector<AABBMinMax> boxes = { AABBMinMax(MathUtils::calculate_vertex_bounds(cube.data(), cube.size())) };
+	CullingVolumes volumes(boxes, frustums);
+
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> pos_dist(-100, 100);
+	std::uniform_real_distribution<float> radius_dist(0.05f, 2.f);
+
+	std::vector<AABBMinMax> bounds(count);
+	std::vector<real_t> x(count), y(count), z(count), radius(count);
+	for (size_t i = 0; i < count; i++) {
+		bounds[i] = SphereBounds(Vector3(pos_dist(rng), pos_dist(rng), pos_dist(rng)), radius_dist(rng));
+		x[i] = bounds[i].center.x;
+		y[i] = bounds[i].center.y;
+		z[i] = bounds[i].center.z;
+		radius[i] = bounds[i].radius;
+	}
+
+	std::vector<uint64_t> mask_old(get_mask_size(count));
+	std::vector<uint64_t> mask_scalar(get_mask_size(count));
+	std::vector<uint64_t> mask_simd(get_mask_size(count));
+
+	// The same checks as in GeometryPoolCullingData::is_visible
+	double old_usec = bench.measure("per_bounds", [&]() {
+		std::fill(mask_old.begin(), mask_old.end(), 0);
+		for (size_t i = 0; i < count; i++) {
+			bool is_visible = false;
+			for (auto &box : boxes) {
+				if (box.intersects(bounds[i])) {
+					is_visible = true;
+					break;
+				}
+			}
+			if (is_visible) {
+				is_visible = false;
+				for (auto &f : frustums) {
+					if (MathUtils::is_bounds_partially_inside_convex_shape(bounds[i], f)) {
+						is_visible = true;
+						break;
+					}
+				}
+			}
+			if (is_visible) {
+				mask_old[i >> 6] |= 1ull << (i & 63);
+			}
+		}
+	});
+
+	double scalar_usec = bench.measure("scalar", [&]() { cull_spheres_scalar(x.data(), y.data(), z.data(), radius.data(), count, volumes, mask_scalar.data()); });
+	double simd_usec = bench.measure("simd", [&]() { cull_spheres(x.data(), y.data(), z.data(), radius.data(), count, volumes, mask_simd.data()); });
+
+	int64_t visible = 0;
+	int64_t mismatches = 0;
+	for (size_t i = 0; i < count; i++) {
+		bool old_vis = (mask_old[i >> 6] >> (i & 63)) & 1;
+		bool simd_vis = (mask_simd[i >> 6] >> (i & 63)) & 1;
+		bool scalar_vis = (mask_scalar[i >> 6] >> (i & 63)) & 1;
+		visible += old_vis;
+		mismatches += (old_vis != simd_vis) || (old_vis != scalar_vis);
+	}
+
+	Dictionary &res = bench.get_results();
+	res["kernel"] = get_kernel_name();
+	res["count"] = (int64_t)count;
+	res["visible"] = visible;
+	res["mismatches"] = mismatches;
+	bench.set_speedup(old_usec, simd_usec);
+
+	DEV_PRINT_STD("Culling benchmark (%s, %d spheres): per bounds %.2f usec, scalar %.2f usec, SIMD %.2f usec, mismatches %d\n", get_kernel_name(), (int)count, old_usec, scalar_usec, simd_usec, (int)mismatches);
+	return res;
+}
+#endif
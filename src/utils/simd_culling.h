@@ -0,0 +1,93 @@
+#pragma once
+
+#include "compiler.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+GODOT_WARNING_DISABLE()
+#include <godot_cpp/variant/builtin_types.hpp>
+GODOT_WARNING_RESTORE()
+using namespace godot;
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+struct AABBMinMax;
+
+/// Boxes and frustums prepared for the batched culling.
+/// Planes and boxes are stored as flat arrays so that the kernels only broadcast values from them.
+struct CullingVolumes {
+	// min.x, min.y, min.z, max.x, max.y, max.z
+	std::vector<real_t> boxes;
+	// normal.x, normal.y, normal.z, d. 6 planes per frustum
+	std::vector<real_t> planes;
+	size_t boxes_count;
+	size_t frustums_count;
+
+	CullingVolumes() :
+			boxes_count(0),
+			frustums_count(0) {}
+	CullingVolumes(const std::vector<AABBMinMax> &p_boxes, const std::vector<std::array<Plane, 6> > &p_frustums);
+};
+
+/// Frustum culling of bounding spheres stored as a structure of arrays.
+/// Uses AVX2 (if supported by the CPU), SSE2 or NEON to test 8 or 4 spheres per iteration.
+/// The scalar version is used for the rest of the spheres, on other platforms and with `precision=double`.
+class CullingUtils {
+public:
+	enum KernelType {
+		KERNEL_SCALAR,
+		KERNEL_SSE2,
+		KERNEL_AVX2,
+		KERNEL_NEON,
+	};
+
+	/// Returns the number of `uint64_t` required to store the visibility of `p_count` spheres.
+	static _FORCE_INLINE_ size_t get_mask_size(const size_t &p_count) {
+		return (p_count + 63) / 64;
+	}
+
+	/// Returns the index of the lowest set bit. `p_bits` must not be zero.
+	static _FORCE_INLINE_ uint32_t get_lowest_bit_index(const uint64_t &p_bits) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+		unsigned long idx;
+		_BitScanForward64(&idx, p_bits);
+		return (uint32_t)idx;
+#elif defined(_MSC_VER)
+		unsigned long idx;
+		if (_BitScanForward(&idx, (unsigned long)p_bits))
+			return (uint32_t)idx;
+		_BitScanForward(&idx, (unsigned long)(p_bits >> 32));
+		return (uint32_t)idx + 32;
+#else
+		return (uint32_t)__builtin_ctzll(p_bits);
+#endif
+	}
+
+	static _FORCE_INLINE_ uint32_t get_set_bits_count(uint64_t p_bits) {
+#if defined(__GNUC__) || defined(__clang__)
+		return (uint32_t)__builtin_popcountll(p_bits);
+#else
+		p_bits = p_bits - ((p_bits >> 1) & 0x5555555555555555ull);
+		p_bits = (p_bits & 0x3333333333333333ull) + ((p_bits >> 2) & 0x3333333333333333ull);
+		p_bits = (p_bits + (p_bits >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+		return (uint32_t)((p_bits * 0x0101010101010101ull) >> 56);
+#endif
+	}
+
+	/// Sets bit `i` of `r_mask` if the sphere `i` intersects any of the boxes and is inside any of the frustums.
+	/// If there are no frustums, only the boxes are checked.
+	static void cull_spheres(const real_t *p_x, const real_t *p_y, const real_t *p_z, const real_t *p_radius, const size_t &p_count, const CullingVolumes &p_volumes, uint64_t *r_mask);
+	static void cull_spheres_scalar(const real_t *p_x, const real_t *p_y, const real_t *p_z, const real_t *p_radius, const size_t &p_count, const CullingVolumes &p_volumes, uint64_t *r_mask);
+
+	static KernelType get_kernel_type();
+	static const char *get_kernel_name();
+
+#ifdef DEV_ENABLED
+	/// Compares the batched culling with the per-bounds culling that was used before.
+	static Dictionary benchmark(const int &p_count, const int &p_iterations);
+#endif
+};
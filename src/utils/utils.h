@@ -382,3 +382,44 @@ public:
 #define GODOT_STOPWATCH(time_val)
 #define GODOT_STOPWATCH_ADD(time_val)
 #endif
+
+#ifdef DEV_ENABLED
+#include <chrono>
+
+/// Measures the implementations compared by the `_benchmark_*` methods and collects the results.
+/// Each time is stored as `<name>_usec`, the other values can be added to `get_results()` directly.
+class DevBenchmark {
+	int iterations;
+	godot::Dictionary results;
+
+public:
+	DevBenchmark(const int &p_iterations) :
+			iterations(std::max(p_iterations, 1)) {
+	}
+
+	int get_iterations() const {
+		return iterations;
+	}
+
+	/// Returns the average time of one call of `p_func` in microseconds.
+	double measure(const godot::String &p_name, const std::function<void()> &p_func) {
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < iterations; i++) {
+			p_func();
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		double usec = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / iterations / 1000.0;
+		results[p_name + "_usec"] = usec;
+		return usec;
+	}
+
+	/// Stores how many times the new implementation is faster than the old one.
+	void set_speedup(const double &p_old_usec, const double &p_new_usec) {
+		results["speedup"] = p_new_usec > 0 ? p_old_usec / p_new_usec : 0.0;
+	}
+
+	godot::Dictionary &get_results() {
+		return results;
+	}
+};
+#endif